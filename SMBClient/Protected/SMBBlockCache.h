@@ -0,0 +1,52 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <Foundation/Foundation.h>
+
+// The size of the blocks cached, blocks start at multiples of it
+extern const NSUInteger SMBBlockCacheBlockSize;
+
+// Keeps the most recently used blocks of a file and watches the access pattern
+// to suggest how far to read ahead
+@interface SMBBlockCache : NSObject
+
+@property (nonatomic, readonly) NSUInteger capacity;
+
+- (nullable instancetype)initWithCapacity:(NSUInteger)capacity;
+
+- (nullable NSData *)blockAtIndex:(unsigned long long)index;
+- (void)setBlock:(nonnull NSData *)block atIndex:(unsigned long long)index;
+- (void)removeAllBlocks;
+
+// Records an access to the blocks from first to last and returns the number of
+// blocks following last that should be read along. The more accesses continue
+// where the previous one ended, the more blocks are read ahead.
+- (NSUInteger)readAheadForBlocksFrom:(unsigned long long)first to:(unsigned long long)last;
+
+#pragma mark - Unavailable methods
+
++ new NS_UNAVAILABLE;
+- init NS_UNAVAILABLE;
+
+@end
@@ -0,0 +1,101 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import "SMBBlockCache.h"
+
+const NSUInteger SMBBlockCacheBlockSize = 128 * 1024;
+
+// Read-ahead is capped at 4 MB
+static const NSUInteger SMBMaximumReadAheadBlocks = 32;
+
+@implementation SMBBlockCache {
+    NSMutableDictionary<NSNumber *, NSData *> *_blocks;
+    NSMutableOrderedSet<NSNumber *> *_recentlyUsed;
+    unsigned long long _nextBlock;
+    NSUInteger _readAhead;
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self) {
+        _capacity = MAX(capacity, 1);
+        _blocks = [NSMutableDictionary dictionaryWithCapacity:_capacity];
+        _recentlyUsed = [NSMutableOrderedSet orderedSetWithCapacity:_capacity];
+    }
+    return self;
+}
+
+- (NSData *)blockAtIndex:(unsigned long long)index {
+    NSNumber *key = @(index);
+    
+    @synchronized (self) {
+        NSData *block = _blocks[key];
+        
+        if (block) {
+            [_recentlyUsed removeObject:key];
+            [_recentlyUsed addObject:key];
+        }
+        return block;
+    }
+}
+
+- (void)setBlock:(NSData *)block atIndex:(unsigned long long)index {
+    NSNumber *key = @(index);
+    
+    @synchronized (self) {
+        _blocks[key] = block;
+        [_recentlyUsed removeObject:key];
+        [_recentlyUsed addObject:key];
+        
+        while (_recentlyUsed.count > _capacity) {
+            [_blocks removeObjectForKey:_recentlyUsed.firstObject];
+            [_recentlyUsed removeObjectAtIndex:0];
+        }
+    }
+}
+
+- (void)removeAllBlocks {
+    @synchronized (self) {
+        [_blocks removeAllObjects];
+        [_recentlyUsed removeAllObjects];
+        _nextBlock = 0;
+        _readAhead = 0;
+    }
+}
+
+- (NSUInteger)readAheadForBlocksFrom:(unsigned long long)first to:(unsigned long long)last {
+    @synchronized (self) {
+        // Continuing in or right after the last block counts as sequential
+        if (first + 1 == _nextBlock || first == _nextBlock) {
+            _readAhead = MIN(MAX(_readAhead * 2, 1), MIN(SMBMaximumReadAheadBlocks, _capacity / 2));
+        } else {
+            _readAhead = 0;
+        }
+        _nextBlock = last + 1;
+        
+        return _readAhead;
+    }
+}
+
+@end
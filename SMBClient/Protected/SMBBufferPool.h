@@ -0,0 +1,57 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <Foundation/Foundation.h>
+
+// Buffers are never larger than this, 8 MB, independent of the size requested
+extern const NSUInteger SMBMaximumBufferSize;
+
+@interface SMBBufferPool : NSObject
+
+// The amount of memory the pool may hold in buffers, in use or idle. Idle buffers
+// are freed to stay below it. Buffers that would exceed it are allocated outside
+// the pool and freed when they are released. A single buffer in the pool is always
+// allowed, even if it's larger than the limit.
+@property (atomic) NSUInteger memoryLimit;
+
+- (nullable instancetype)initWithMemoryLimit:(NSUInteger)memoryLimit;
+
+// Rounds the size up to whole pages, capped at SMBMaximumBufferSize
++ (NSUInteger)bufferSize:(NSUInteger)requestedSize;
+
+// Returns a page aligned buffer of bufferSize: bytes, so no more than 8 MB whatever
+// the size requested. Never waits for buffers in use. Returns NULL if the memory
+// can't be allocated.
+- (nullable void *)acquireBuffer:(NSUInteger)requestedSize;
+- (void)releaseBuffer:(nonnull void *)buffer size:(NSUInteger)requestedSize;
+
+// Wraps a buffer without copying it. The buffer is released when the data is deallocated.
+- (nonnull NSData *)dataWithBuffer:(nonnull void *)buffer size:(NSUInteger)requestedSize length:(NSUInteger)length;
+
+#pragma mark - Unavailable methods
+
++ new NS_UNAVAILABLE;
+- init NS_UNAVAILABLE;
+
+@end
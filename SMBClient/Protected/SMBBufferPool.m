@@ -0,0 +1,169 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import "SMBBufferPool.h"
+
+#import <stdlib.h>
+#import <unistd.h>
+
+const NSUInteger SMBMaximumBufferSize = 8 * 1024 * 1024;
+
+@implementation SMBBufferPool {
+    NSMutableDictionary<NSNumber *, NSMutableArray<NSValue *> *> *_idleBuffers;
+    // Buffers allocated beyond the memory limit, which are freed when released
+    NSMutableSet<NSValue *> *_unpooledBuffers;
+    NSLock *_lock;
+    NSUInteger _memoryLimit;
+    NSUInteger _allocated;
+    NSUInteger _idle;
+}
+
++ (NSUInteger)bufferSize:(NSUInteger)requestedSize {
+    NSUInteger pageSize = (NSUInteger)getpagesize();
+    NSUInteger size = MIN(MAX(requestedSize, 1), SMBMaximumBufferSize);
+    
+    return (size + pageSize - 1) / pageSize * pageSize;
+}
+
+- (instancetype)initWithMemoryLimit:(NSUInteger)memoryLimit {
+    self = [super init];
+    if (self) {
+        _memoryLimit = memoryLimit;
+        _idleBuffers = [NSMutableDictionary dictionary];
+        _unpooledBuffers = [NSMutableSet set];
+        _lock = [NSLock new];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    for (NSMutableArray<NSValue *> *buffers in _idleBuffers.allValues) {
+        for (NSValue *buffer in buffers) {
+            free(buffer.pointerValue);
+        }
+    }
+}
+
+- (NSUInteger)memoryLimit {
+    [_lock lock];
+    
+    NSUInteger memoryLimit = _memoryLimit;
+    
+    [_lock unlock];
+    
+    return memoryLimit;
+}
+
+- (void)setMemoryLimit:(NSUInteger)memoryLimit {
+    [_lock lock];
+    
+    _memoryLimit = memoryLimit;
+    
+    [_lock unlock];
+}
+
+- (void *)acquireBuffer:(NSUInteger)requestedSize {
+    NSUInteger size = [SMBBufferPool bufferSize:requestedSize];
+    void *buffer = NULL;
+    
+    [_lock lock];
+    
+    NSMutableArray<NSValue *> *buffers = _idleBuffers[@(size)];
+    
+    if (buffers.count > 0) {
+        buffer = buffers.lastObject.pointerValue;
+        [buffers removeLastObject];
+        _idle -= size;
+    } else {
+        // Idle buffers of other sizes make room for the new one
+        for (NSNumber *idleSize in _idleBuffers.allKeys) {
+            NSMutableArray<NSValue *> *idleBuffers = _idleBuffers[idleSize];
+            
+            while (idleBuffers.count > 0 && _allocated + size > _memoryLimit) {
+                free(idleBuffers.lastObject.pointerValue);
+                [idleBuffers removeLastObject];
+                _allocated -= idleSize.unsignedIntegerValue;
+                _idle -= idleSize.unsignedIntegerValue;
+            }
+        }
+        
+        // Callers may keep the data of buffers as long as they like, so buffers in
+        // use aren't waited for. Those beyond the limit aren't kept when released.
+        BOOL pooled = _allocated == 0 || _allocated + size <= _memoryLimit;
+        
+        if (posix_memalign(&buffer, (size_t)getpagesize(), size) != 0) {
+            buffer = NULL;
+        } else if (pooled) {
+            _allocated += size;
+        } else {
+            [_unpooledBuffers addObject:[NSValue valueWithPointer:buffer]];
+        }
+    }
+    
+    [_lock unlock];
+    
+    return buffer;
+}
+
+- (void)releaseBuffer:(void *)buffer size:(NSUInteger)requestedSize {
+    NSUInteger size = [SMBBufferPool bufferSize:requestedSize];
+    NSValue *value = [NSValue valueWithPointer:buffer];
+    
+    [_lock lock];
+    
+    if ([_unpooledBuffers containsObject:value]) {
+        [_unpooledBuffers removeObject:value];
+        free(buffer);
+    } else if (_allocated > _memoryLimit) {
+        _allocated -= size;
+        free(buffer);
+    } else {
+        NSMutableArray<NSValue *> *buffers = _idleBuffers[@(size)];
+        
+        if (buffers == nil) {
+            buffers = [NSMutableArray array];
+            _idleBuffers[@(size)] = buffers;
+        }
+        [buffers addObject:value];
+        _idle += size;
+    }
+    
+    [_lock unlock];
+}
+
+- (NSData *)dataWithBuffer:(void *)buffer size:(NSUInteger)requestedSize length:(NSUInteger)length {
+    __weak SMBBufferPool *weakSelf = self;
+    
+    return [[NSData alloc] initWithBytesNoCopy:buffer length:length deallocator:^(void *bytes, NSUInteger len) {
+        SMBBufferPool *pool = weakSelf;
+        
+        if (pool) {
+            [pool releaseBuffer:buffer size:requestedSize];
+        } else {
+            free(buffer);
+        }
+    }];
+}
+
+@end
@@ -0,0 +1,56 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <Foundation/Foundation.h>
+
+@class SMBStat;
+
+// Keeps copies of files of a share on disk. A copy is only handed out as long as
+// the size and timestamps of the remote file match those it was stored with.
+// Copies that weren't used for the longest time are removed to stay within the
+// size limit.
+@interface SMBContentCache : NSObject
+
+// The cache is disabled as long as this is 0
+@property (atomic) unsigned long long sizeLimit;
+
+// The cache of the directory, shared by all its users as long as one is left
++ (nullable instancetype)cacheWithDirectory:(nonnull NSString *)directory;
+
+- (nullable instancetype)initWithDirectory:(nonnull NSString *)directory;
+
+// The local copy of the file at path, if it is still current
+- (nullable NSString *)pathOfFile:(nonnull NSString *)path status:(nonnull SMBStat *)stat;
+// A new path in the cache directory to write a copy to before it is stored
+- (nullable NSString *)temporaryPath;
+// Moves or copies the local file into the cache, replacing older copies of path
+- (void)storeFile:(nonnull NSString *)localPath forFile:(nonnull NSString *)path status:(nonnull SMBStat *)stat move:(BOOL)move;
+- (void)removeAll;
+
+#pragma mark - Unavailable methods
+
++ new NS_UNAVAILABLE;
+- init NS_UNAVAILABLE;
+
+@end
@@ -0,0 +1,223 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import "SMBContentCache.h"
+#import "SMBShare_Protected.h"
+
+#import <CommonCrypto/CommonDigest.h>
+
+@implementation SMBContentCache {
+    NSString *_directory;
+    NSString *_temporaryDirectory;
+    // The sizes of the copies by name, and their total. The directory is only
+    // looked at once, stores keep track of the copies afterwards.
+    NSMutableDictionary<NSString *, NSNumber *> *_copies;
+    unsigned long long _size;
+}
+
++ (instancetype)cacheWithDirectory:(NSString *)directory {
+    static NSMapTable<NSString *, SMBContentCache *> *caches;
+    static dispatch_once_t onceToken;
+    
+    dispatch_once(&onceToken, ^{
+        caches = [NSMapTable strongToWeakObjectsMapTable];
+    });
+    
+    @synchronized (caches) {
+        SMBContentCache *cache = [caches objectForKey:directory];
+        
+        if (cache == nil) {
+            cache = [[SMBContentCache alloc] initWithDirectory:directory];
+            [caches setObject:cache forKey:directory];
+        }
+        
+        return cache;
+    }
+}
+
+- (instancetype)initWithDirectory:(NSString *)directory {
+    self = [super init];
+    if (self) {
+        _directory = directory;
+        _temporaryDirectory = [directory stringByAppendingPathComponent:@".tmp"];
+    }
+    return self;
+}
+
+- (NSString *)pathOfFile:(NSString *)path status:(SMBStat *)stat {
+    if (self.sizeLimit == 0) {
+        return nil;
+    }
+    
+    NSString *localPath = [_directory stringByAppendingPathComponent:[self _nameOfFile:path status:stat]];
+    
+    // The modification date of a copy is when it was last used
+    if (![[NSFileManager defaultManager] setAttributes:@{NSFileModificationDate: [NSDate date]} ofItemAtPath:localPath error:nil]) {
+        return nil;
+    }
+    
+    return localPath;
+}
+
+- (NSString *)temporaryPath {
+    if (![[NSFileManager defaultManager] createDirectoryAtPath:_temporaryDirectory withIntermediateDirectories:YES attributes:nil error:nil]) {
+        return nil;
+    }
+    
+    return [_temporaryDirectory stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+}
+
+- (void)storeFile:(NSString *)localPath forFile:(NSString *)path status:(SMBStat *)stat move:(BOOL)move {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    unsigned long long sizeLimit = self.sizeLimit;
+    
+    if (sizeLimit == 0 || stat.size > sizeLimit) {
+        if (move) {
+            [fileManager removeItemAtPath:localPath error:nil];
+        }
+        return;
+    }
+    
+    @synchronized (self) {
+        NSString *name = [self _nameOfFile:path status:stat];
+        NSString *prefix = [self _nameOfFile:path status:nil];
+        NSString *cachePath = [_directory stringByAppendingPathComponent:name];
+        BOOL stored;
+        
+        [fileManager createDirectoryAtPath:_directory withIntermediateDirectories:YES attributes:nil error:nil];
+        [self _loadCopies];
+        
+        for (NSString *file in _copies.allKeys) {
+            if ([file hasPrefix:prefix] && [fileManager removeItemAtPath:[_directory stringByAppendingPathComponent:file] error:nil]) {
+                _size -= _copies[file].unsignedLongLongValue;
+                [_copies removeObjectForKey:file];
+            }
+        }
+        
+        if (move) {
+            stored = [fileManager moveItemAtPath:localPath toPath:cachePath error:nil];
+        } else {
+            stored = [fileManager copyItemAtPath:localPath toPath:cachePath error:nil];
+        }
+        
+        if (stored) {
+            unsigned long long size = [fileManager attributesOfItemAtPath:cachePath error:nil].fileSize;
+            
+            [fileManager setAttributes:@{NSFileModificationDate: [NSDate date]} ofItemAtPath:cachePath error:nil];
+            _copies[name] = @(size);
+            _size += size;
+            
+            if (_size > sizeLimit) {
+                [self _trimToSize:sizeLimit];
+            }
+        } else if (move) {
+            [fileManager removeItemAtPath:localPath error:nil];
+        }
+    }
+}
+
+- (void)removeAll {
+    @synchronized (self) {
+        [[NSFileManager defaultManager] removeItemAtPath:_directory error:nil];
+        _copies = nil;
+        _size = 0;
+    }
+}
+
+#pragma mark - Private methods
+
+// Copies are named by a hash of the path, followed by the size and timestamps of
+// the file. Without a status, this is the prefix of all copies of the path.
+- (NSString *)_nameOfFile:(NSString *)path status:(SMBStat *)stat {
+    NSData *key = [path.lowercaseString dataUsingEncoding:NSUTF8StringEncoding];
+    unsigned char digest[CC_SHA1_DIGEST_LENGTH];
+    NSMutableString *name = [NSMutableString stringWithCapacity:CC_SHA1_DIGEST_LENGTH * 2 + 64];
+    
+    CC_SHA1(key.bytes, (CC_LONG)key.length, digest);
+    
+    for (NSUInteger i = 0; i < CC_SHA1_DIGEST_LENGTH; i++) {
+        [name appendFormat:@"%02x", digest[i]];
+    }
+    
+    [name appendString:@"-"];
+    
+    if (stat) {
+        [name appendFormat:@"%llu-%llu-%llu", stat.size, stat.writeTimestamp, stat.modificationTimestamp];
+    }
+    
+    return name;
+}
+
+// Reads the sizes of the copies already on disk
+- (void)_loadCopies {
+    if (_copies) {
+        return;
+    }
+    
+    NSURL *directory = [NSURL fileURLWithPath:_directory isDirectory:YES];
+    NSArray<NSURL *> *files = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:directory includingPropertiesForKeys:@[NSURLFileSizeKey] options:NSDirectoryEnumerationSkipsHiddenFiles error:nil];
+    
+    _copies = [NSMutableDictionary dictionaryWithCapacity:files.count];
+    _size = 0;
+    
+    for (NSURL *file in files) {
+        NSNumber *size = nil;
+        
+        if ([file getResourceValue:&size forKey:NSURLFileSizeKey error:nil] && size) {
+            _copies[file.lastPathComponent] = size;
+            _size += size.unsignedLongLongValue;
+        }
+    }
+}
+
+// Removes the least recently used copies until the rest fits into the limit
+- (void)_trimToSize:(unsigned long long)sizeLimit {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSMutableArray<NSDictionary *> *copies = [NSMutableArray arrayWithCapacity:_copies.count];
+    
+    for (NSString *name in _copies) {
+        NSDate *date = [fileManager attributesOfItemAtPath:[_directory stringByAppendingPathComponent:name] error:nil].fileModificationDate;
+        
+        [copies addObject:@{@"name": name, @"date": date ?: [NSDate distantPast]}];
+    }
+    
+    [copies sortUsingDescriptors:@[[NSSortDescriptor sortDescriptorWithKey:@"date" ascending:YES]]];
+    
+    for (NSDictionary *copy in copies) {
+        if (_size <= sizeLimit) {
+            break;
+        }
+        
+        NSString *name = copy[@"name"];
+        NSString *path = [_directory stringByAppendingPathComponent:name];
+        
+        // A copy that is already gone doesn't take up space either
+        if ([fileManager removeItemAtPath:path error:nil] || ![fileManager fileExistsAtPath:path]) {
+            _size -= _copies[name].unsignedLongLongValue;
+            [_copies removeObjectForKey:name];
+        }
+    }
+}
+
+@end
@@ -33,6 +33,7 @@
 + (NSError *)notConnectedError;
 + (NSError *)notOpenError;
 + (NSError *)notSuchFileOrDirectory;
++ (NSError *)notADirectoryError;
 + (NSError *)writeError;
 + (NSError *)readError;
 + (NSError *)seekError;
@@ -23,6 +23,7 @@
 // -----------------------------------------------------------------------------
 
 #import "SMBError.h"
+#import "SMBSession.h"
 
 @implementation SMBError
 
@@ -62,10 +63,16 @@
     return [NSError errorWithDomain:@"smb.error" code:58 userInfo:@{ NSLocalizedDescriptionKey : @"No such file or directory"} ];
 }
 
++ (NSError *)notADirectoryError {
+    return [NSError errorWithDomain:@"smb.error" code:59 userInfo:@{ NSLocalizedDescriptionKey : @"Not a directory"} ];
+}
+
 + (NSError *)dsmError:(int)dsmError session:(smb_session *)session {
     NSString *domain = @"dsm.error";
     NSError *error = nil;
     
+    [SMBSession noteError:dsmError session:session];
+    
     switch (dsmError) {
         case DSM_SUCCESS:
             break;
@@ -26,11 +26,47 @@
 
 #import "smb_session.h"
 
+@class SMBBufferPool;
+@class SMBSession;
+@class SMBMetricsRecorder;
+
 @interface SMBFileServer ()
 
 @property (nonatomic, assign, readonly, nullable) smb_session *smbSession;
+@property (nonatomic, readonly, nonnull) SMBBufferPool *bufferPool;
+@property (nonatomic, readonly, nonnull) SMBMetricsRecorder *metricsRecorder;
+
+// Identifies host and credentials of the last connect in the session registry
+@property (nonatomic, readonly, nullable) NSString *sessionKey;
+// The domain and user of the last connect, without the password
+@property (nonatomic, readonly, nullable) NSString *account;
 
+// Creates an additional session, authenticated with the credentials of the last
+// successful connect. The caller owns the session and must destroy or recycle it.
+- (nullable smb_session *)createSession:(NSError *_Nullable *_Nullable)error;
+// Like createSession, but takes over an idle session of the registry if there is
+// one, adding the trees still connected on it to `shareIDs`
+- (nullable smb_session *)createSession:(NSError *_Nullable *_Nullable)error shareIDs:(nullable NSMutableDictionary<NSString *, NSNumber *> *)shareIDs;
+// Leaves a session created by this server to the registry
+- (void)recycleSession:(nonnull smb_session *)session shareIDs:(nullable NSDictionary<NSString *, NSNumber *> *)shareIDs;
+// Keeps a session of a transfer for the next one on this server, for up to a
+// minute or until the server disconnects. Kept sessions aren't probed when they
+// are taken, adding the trees still connected on them to `shareIDs`.
+- (void)keepSession:(nonnull smb_session *)session shareIDs:(nullable NSDictionary<NSString *, NSNumber *> *)shareIDs;
+- (nullable smb_session *)keptSession:(nonnull NSMutableDictionary<NSString *, NSNumber *> *)shareIDs;
+// Like createSession, but fails right away for a while after failed attempts,
+// backing off up to a minute, so lost sessions don't all reconnect at once
+- (nullable smb_session *)reconnectSession:(NSError *_Nullable *_Nullable)error;
+// Hands the session of the server over to its replacement after a reconnect. Must
+// be called on the queue of the server.
+- (void)replaceSession:(nonnull smb_session *)session with:(nonnull smb_session *)newSession;
+// Runs the block on the queue of an idle session, or on the least busy one if
+// the pool is exhausted. The session is nil if the server is not connected.
+- (void)performOnSession:(nonnull void (^)(SMBSession *_Nullable session))block;
+// Calls the block on the completion queue, or right away for directCompletions
+- (void)dispatchCompletion:(nonnull dispatch_block_t)block;
+// These complete on the queue of the server
 - (void)openShare:(nonnull NSString *)name completion:(nullable void (^)(smb_tid tid, NSError * _Nullable error))completion;
-- (void)closeShare:(smb_tid)shareID completion:(nullable void (^)(NSError * _Nullable error))completion;
+- (void)closeShare:(nonnull NSString *)name completion:(nullable void (^)(NSError * _Nullable error))completion;
 
 @end
\ No newline at end of file
@@ -0,0 +1,51 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <Foundation/Foundation.h>
+
+@class SMBStat;
+
+// Remembers the status of paths and the contents of directories of a share for
+// a limited time. Paths are compared case insensitively, as the server does.
+@interface SMBMetadataCache : NSObject
+
+// The time entries stay valid. The cache is disabled as long as this is 0.
+@property (atomic) NSTimeInterval lifetime;
+
+// Counts the invalidations. Take it before asking the server, and pass it along
+// when storing the answer, which is dropped if the cache was invalidated meanwhile.
+@property (atomic, readonly) NSUInteger generation;
+
+- (nullable SMBStat *)statForPath:(nonnull NSString *)path;
+- (void)setStat:(nonnull SMBStat *)stat forPath:(nonnull NSString *)path generation:(NSUInteger)generation;
+
+// The listing is the status of every entry of the directory, without '.' and '..'
+- (nullable NSArray<SMBStat *> *)listingForPath:(nonnull NSString *)path;
+- (void)setListing:(nonnull NSArray<SMBStat *> *)listing forPath:(nonnull NSString *)path generation:(NSUInteger)generation;
+
+// Drops the path, anything below it and the listing of its parent
+- (void)invalidatePath:(nonnull NSString *)path;
+- (void)invalidateAll;
+
+@end
@@ -0,0 +1,192 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import "SMBMetadataCache.h"
+#import "SMBShare_Protected.h"
+
+@interface SMBMetadataCacheEntry : NSObject
+
+@property (nonatomic) SMBStat *stat;
+@property (nonatomic) NSDate *statTime;
+@property (nonatomic) NSArray<SMBStat *> *listing;
+@property (nonatomic) NSDate *listingTime;
+
+@end
+
+@implementation SMBMetadataCacheEntry
+@end
+
+@implementation SMBMetadataCache {
+    NSMutableDictionary<NSString *, SMBMetadataCacheEntry *> *_entries;
+    NSUInteger _generation;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _entries = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+- (NSUInteger)generation {
+    @synchronized (self) {
+        return _generation;
+    }
+}
+
+- (SMBStat *)statForPath:(NSString *)path {
+    NSTimeInterval lifetime = self.lifetime;
+    
+    if (lifetime <= 0) {
+        return nil;
+    }
+    
+    @synchronized (self) {
+        SMBMetadataCacheEntry *entry = _entries[[self _keyForPath:path]];
+        
+        if (entry.stat && -entry.statTime.timeIntervalSinceNow < lifetime) {
+            return entry.stat;
+        }
+    }
+    return nil;
+}
+
+- (void)setStat:(SMBStat *)stat forPath:(NSString *)path generation:(NSUInteger)generation {
+    if (self.lifetime <= 0) {
+        return;
+    }
+    
+    @synchronized (self) {
+        if (generation != _generation) {
+            return;
+        }
+        
+        SMBMetadataCacheEntry *entry = [self _entryForKey:[self _keyForPath:path]];
+        
+        entry.stat = stat;
+        entry.statTime = [NSDate new];
+    }
+}
+
+- (NSArray<SMBStat *> *)listingForPath:(NSString *)path {
+    NSTimeInterval lifetime = self.lifetime;
+    
+    if (lifetime <= 0) {
+        return nil;
+    }
+    
+    @synchronized (self) {
+        SMBMetadataCacheEntry *entry = _entries[[self _keyForPath:path]];
+        
+        if (entry.listing && -entry.listingTime.timeIntervalSinceNow < lifetime) {
+            return entry.listing;
+        }
+    }
+    return nil;
+}
+
+- (void)setListing:(NSArray<SMBStat *> *)listing forPath:(NSString *)path generation:(NSUInteger)generation {
+    if (self.lifetime <= 0) {
+        return;
+    }
+    
+    @synchronized (self) {
+        if (generation != _generation) {
+            return;
+        }
+        
+        NSString *key = [self _keyForPath:path];
+        NSDate *now = [NSDate new];
+        SMBMetadataCacheEntry *entry = [self _entryForKey:key];
+        
+        entry.listing = listing;
+        entry.listingTime = now;
+        
+        // The entries of the listing are as good as a stat of each of them
+        for (SMBStat *stat in listing) {
+            SMBMetadataCacheEntry *child = [self _entryForKey:[self _keyForPath:[key stringByAppendingPathComponent:stat.smbName]]];
+            
+            child.stat = stat;
+            child.statTime = now;
+        }
+    }
+}
+
+- (void)invalidatePath:(NSString *)path {
+    NSString *key = [self _keyForPath:path];
+    NSString *prefix = [key isEqualToString:@"/"] ? key : [key stringByAppendingString:@"/"];
+    NSString *parentKey = [self _keyForPath:key.stringByDeletingLastPathComponent];
+    
+    @synchronized (self) {
+        _generation++;
+        [_entries removeObjectForKey:key];
+        
+        for (NSString *k in _entries.allKeys) {
+            if ([k hasPrefix:prefix]) {
+                [_entries removeObjectForKey:k];
+            }
+        }
+        
+        if (![parentKey isEqualToString:key]) {
+            _entries[parentKey].listing = nil;
+        }
+    }
+}
+
+- (void)invalidateAll {
+    @synchronized (self) {
+        _generation++;
+        [_entries removeAllObjects];
+    }
+}
+
+#pragma mark - Private methods
+
+- (NSString *)_keyForPath:(NSString *)path {
+    NSString *key = [path stringByReplacingOccurrencesOfString:@"\\" withString:@"/"].lowercaseString;
+    
+    while ([key hasSuffix:@"/"]) {
+        key = [key substringToIndex:key.length - 1];
+    }
+    
+    if (![key hasPrefix:@"/"]) {
+        key = [@"/" stringByAppendingString:key];
+    }
+    
+    return key;
+}
+
+- (SMBMetadataCacheEntry *)_entryForKey:(NSString *)key {
+    SMBMetadataCacheEntry *entry = _entries[key];
+    
+    if (entry == nil) {
+        entry = [SMBMetadataCacheEntry new];
+        _entries[key] = entry;
+    }
+    
+    return entry;
+}
+
+@end
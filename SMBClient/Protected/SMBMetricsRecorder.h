@@ -0,0 +1,73 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import "SMBMetrics.h"
+
+#import "smb_file.h"
+
+@interface SMBOperationMetrics ()
+
+- (nonnull instancetype)initWithCount:(NSUInteger)count failures:(NSUInteger)failures inFlight:(NSUInteger)inFlight bytes:(unsigned long long)bytes totalDuration:(NSTimeInterval)totalDuration maximumDuration:(NSTimeInterval)maximumDuration histogram:(nonnull NSArray<NSNumber *> *)histogram;
+
+@end
+
+@interface SMBMetrics ()
+
+- (nonnull instancetype)initWithOperations:(nonnull NSArray<SMBOperationMetrics *> *)operations queueWait:(nonnull SMBOperationMetrics *)queueWait;
+
+@end
+
+// Collects the metrics of a server, share or file and passes everything on to
+// the recorder of the object it belongs to, so a server sums up its shares and
+// a share its files
+@interface SMBMetricsRecorder : NSObject
+
+// Emits a signpost interval for each operation, where available. Only the
+// setting of the recorder at the top counts.
+@property (atomic) BOOL signpostsEnabled;
+
+- (nullable instancetype)initWithParent:(nullable SMBMetricsRecorder *)parent;
+
+// Returns the start to pass to end:start:result:. Results below 0 are failures,
+// as are results other than 0 except for reads and writes, where they are bytes.
+- (uint64_t)begin:(SMBOperation)operation;
+- (void)end:(SMBOperation)operation start:(uint64_t)start result:(long)result;
+// Reads and writes of libdsm, recorded
+- (ssize_t)read:(nonnull smb_session *)session file:(smb_fd)fd buffer:(nonnull void *)buffer length:(size_t)length;
+- (ssize_t)write:(nonnull smb_session *)session file:(smb_fd)fd buffer:(nonnull const void *)buffer length:(size_t)length;
+// Records the wait of an operation that was queued at the given time
+- (void)waitedSince:(uint64_t)enqueued;
+
+- (nonnull SMBMetrics *)snapshot;
+- (void)reset;
+
+// The current time in the units of begin:
++ (uint64_t)now;
+
+#pragma mark - Unavailable methods
+
++ new NS_UNAVAILABLE;
+- init NS_UNAVAILABLE;
+
+@end
@@ -0,0 +1,235 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import "SMBMetricsRecorder.h"
+#import "SMBSession.h"
+
+#import <mach/mach_time.h>
+#import <os/signpost.h>
+
+#define SMBHistogramBucketCount 17
+
+typedef struct {
+    NSUInteger count;
+    NSUInteger failures;
+    NSUInteger inFlight;
+    unsigned long long bytes;
+    uint64_t totalDuration;
+    uint64_t maximumDuration;
+    NSUInteger histogram[SMBHistogramBucketCount];
+} SMBCounters;
+
+static const char *SMBOperationNames[] = {"connect", "login", "tree connect", "find", "stat", "open", "read", "write", "close"};
+
+@implementation SMBMetricsRecorder {
+    SMBMetricsRecorder *_parent;
+    SMBCounters _operations[SMBOperationClose + 1];
+    SMBCounters _queueWait;
+}
+
++ (uint64_t)now {
+    return mach_absolute_time();
+}
+
+- (instancetype)initWithParent:(SMBMetricsRecorder *)parent {
+    self = [super init];
+    if (self) {
+        _parent = parent;
+    }
+    return self;
+}
+
+// The lowest bit of the start tells end:start:result: whether a signpost interval
+// was begun, so turning signposts on or off in between leaves none unbalanced
+- (uint64_t)begin:(SMBOperation)operation {
+    BOOL signposted = [self _root].signpostsEnabled;
+    uint64_t start = signposted ? mach_absolute_time() | 1 : mach_absolute_time() & ~1ULL;
+    
+    for (SMBMetricsRecorder *recorder = self; recorder; recorder = recorder->_parent) {
+        @synchronized (recorder) {
+            recorder->_operations[operation].inFlight++;
+        }
+    }
+    
+    if (signposted) {
+        if (@available(iOS 12.0, macOS 10.14, *)) {
+            os_signpost_interval_begin([self _log], (os_signpost_id_t)start, "Operation", "%{public}s", SMBOperationNames[operation]);
+        }
+    }
+    
+    return start;
+}
+
+- (void)end:(SMBOperation)operation start:(uint64_t)start result:(long)result {
+    uint64_t now = mach_absolute_time();
+    uint64_t duration = now > start ? now - start : 0;
+    BOOL transfer = operation == SMBOperationRead || operation == SMBOperationWrite;
+    BOOL failed = transfer ? result < 0 : result != 0;
+    
+    for (SMBMetricsRecorder *recorder = self; recorder; recorder = recorder->_parent) {
+        @synchronized (recorder) {
+            SMBCounters *counters = &recorder->_operations[operation];
+            
+            if (counters->inFlight > 0) {
+                counters->inFlight--;
+            }
+            if (failed) {
+                counters->failures++;
+            } else if (transfer) {
+                counters->bytes += result;
+            }
+            [recorder _add:duration to:counters];
+        }
+    }
+    
+    if (start & 1) {
+        if (@available(iOS 12.0, macOS 10.14, *)) {
+            os_signpost_interval_end([self _log], (os_signpost_id_t)start, "Operation", "%{public}s %ld", SMBOperationNames[operation], result);
+        }
+    }
+}
+
+- (ssize_t)read:(smb_session *)session file:(smb_fd)fd buffer:(void *)buffer length:(size_t)length {
+    uint64_t start = [self begin:SMBOperationRead];
+    ssize_t result = smb_fread(session, fd, buffer, length);
+    
+    [self end:SMBOperationRead start:start result:result];
+    
+    if (result < 0) {
+        [SMBSession noteError:(int)result session:session];
+    }
+    
+    return result;
+}
+
+- (ssize_t)write:(smb_session *)session file:(smb_fd)fd buffer:(const void *)buffer length:(size_t)length {
+    uint64_t start = [self begin:SMBOperationWrite];
+    ssize_t result = smb_fwrite(session, fd, (void *)buffer, length);
+    
+    [self end:SMBOperationWrite start:start result:result];
+    
+    if (result < 0) {
+        [SMBSession noteError:(int)result session:session];
+    }
+    
+    return result;
+}
+
+- (void)waitedSince:(uint64_t)enqueued {
+    uint64_t duration = mach_absolute_time() - enqueued;
+    
+    for (SMBMetricsRecorder *recorder = self; recorder; recorder = recorder->_parent) {
+        @synchronized (recorder) {
+            [recorder _add:duration to:&recorder->_queueWait];
+        }
+    }
+}
+
+- (SMBMetrics *)snapshot {
+    NSMutableArray<SMBOperationMetrics *> *operations = [NSMutableArray arrayWithCapacity:SMBOperationCount];
+    SMBOperationMetrics *queueWait;
+    
+    @synchronized (self) {
+        for (NSUInteger i = 0; i < SMBOperationCount; i++) {
+            [operations addObject:[self _metricsOf:&_operations[i]]];
+        }
+        queueWait = [self _metricsOf:&_queueWait];
+    }
+    
+    return [[SMBMetrics alloc] initWithOperations:operations queueWait:queueWait];
+}
+
+- (void)reset {
+    @synchronized (self) {
+        for (NSUInteger i = 0; i < SMBOperationCount; i++) {
+            NSUInteger inFlight = _operations[i].inFlight;
+            
+            memset(&_operations[i], 0, sizeof(SMBCounters));
+            _operations[i].inFlight = inFlight;
+        }
+        memset(&_queueWait, 0, sizeof(SMBCounters));
+    }
+}
+
+#pragma mark - Private methods
+
+- (SMBMetricsRecorder *)_root {
+    SMBMetricsRecorder *root = self;
+    
+    while (root->_parent) {
+        root = root->_parent;
+    }
+    
+    return root;
+}
+
+- (os_log_t)_log API_AVAILABLE(ios(12.0), macos(10.14)) {
+    static os_log_t log;
+    static dispatch_once_t onceToken;
+    
+    dispatch_once(&onceToken, ^{
+        log = os_log_create("de.naxos-software.SMBClient", "Operations");
+    });
+    
+    return log;
+}
+
+// Must be called while synchronized
+- (void)_add:(uint64_t)duration to:(SMBCounters *)counters {
+    NSArray<NSNumber *> *bounds = [SMBMetrics histogramBounds];
+    NSTimeInterval seconds = [self _seconds:duration];
+    NSUInteger bucket = 0;
+    
+    while (bucket < SMBHistogramBucketCount - 1 && seconds > bounds[bucket].doubleValue) {
+        bucket++;
+    }
+    
+    counters->count++;
+    counters->totalDuration += duration;
+    counters->maximumDuration = MAX(counters->maximumDuration, duration);
+    counters->histogram[bucket]++;
+}
+
+- (SMBOperationMetrics *)_metricsOf:(SMBCounters *)counters {
+    NSMutableArray<NSNumber *> *histogram = [NSMutableArray arrayWithCapacity:SMBHistogramBucketCount];
+    
+    for (NSUInteger i = 0; i < SMBHistogramBucketCount; i++) {
+        [histogram addObject:@(counters->histogram[i])];
+    }
+    
+    return [[SMBOperationMetrics alloc] initWithCount:counters->count failures:counters->failures inFlight:counters->inFlight bytes:counters->bytes totalDuration:[self _seconds:counters->totalDuration] maximumDuration:[self _seconds:counters->maximumDuration] histogram:histogram];
+}
+
+- (NSTimeInterval)_seconds:(uint64_t)machTime {
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    
+    return (double)machTime * timebase.numer / timebase.denom / NSEC_PER_SEC;
+}
+
+@end
@@ -0,0 +1,59 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <Foundation/Foundation.h>
+
+#import <netinet/in.h>
+
+// Resolves host names to IPv4 addresses, the only kind libdsm connects to, and
+// remembers them for a while. Addresses learned by discovery are used without
+// asking DNS. Host names are compared case insensitively.
+@interface SMBResolver : NSObject
+
+// The time resolved addresses are reused. Defaults to 60 seconds, 0 disables the
+// cache.
+@property (atomic) NSTimeInterval timeToLive;
+
++ (nonnull instancetype)sharedResolver;
+
+// The addresses of the host, in network byte order. Blocks while asking DNS.
+- (nullable NSArray<NSNumber *> *)addressesOfHost:(nonnull NSString *)host error:(NSError *_Nullable *_Nullable)error;
+// Remembers an address learned otherwise, e.g. by discovery, until it is removed
+- (void)addAddress:(in_addr_t)address forHost:(nonnull NSString *)host;
+// Moves the address to the front, so it's tried first next time, and remembers
+// that it accepted a connection just now
+- (void)preferAddress:(in_addr_t)address forHost:(nonnull NSString *)host;
+// The address that was last preferred, as long as that's less than timeToLive ago.
+// Connecting to it needn't wait for the other addresses to be probed.
+- (nullable NSNumber *)verifiedAddressOfHost:(nonnull NSString *)host;
+- (void)removeAddressesOfHost:(nonnull NSString *)host;
+- (void)removeAllAddresses;
+
+// The first of the addresses that accepts a connection on the port. Connections
+// are attempted in the order given, each one started a moment after the previous
+// one or as soon as it failed, and all but the first successful one are dropped.
+// Returns the first address if none can be reached in time.
+- (in_addr_t)reachableAddress:(nonnull NSArray<NSNumber *> *)addresses port:(in_port_t)port timeout:(NSTimeInterval)timeout;
+
+@end
@@ -0,0 +1,306 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import "SMBResolver.h"
+#import "SMBError.h"
+
+#import <arpa/inet.h>
+#import <netdb.h>
+#import <poll.h>
+#import <fcntl.h>
+#import <unistd.h>
+
+// The delay before the next address is tried while the previous one is pending
+static const NSTimeInterval SMBResolverAttemptDelay = 0.25;
+static const NSUInteger SMBResolverMaxAttempts = 8;
+
+@interface SMBResolverEntry : NSObject
+
+@property (nonatomic) NSMutableArray<NSNumber *> *addresses;
+@property (nonatomic) NSDate *time;
+// The address that accepted the last connection, and when
+@property (nonatomic) NSNumber *verifiedAddress;
+@property (nonatomic) NSDate *verifiedTime;
+
+@end
+
+@implementation SMBResolverEntry
+@end
+
+@implementation SMBResolver {
+    NSMutableDictionary<NSString *, SMBResolverEntry *> *_entries;
+}
+
++ (instancetype)sharedResolver {
+    static dispatch_once_t pred = 0;
+    __strong static id _sharedObject = nil;
+    dispatch_once(&pred, ^{
+        _sharedObject = [[self alloc] init];
+    });
+    return _sharedObject;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _entries = [NSMutableDictionary dictionary];
+        _timeToLive = 60;
+    }
+    return self;
+}
+
+- (NSArray<NSNumber *> *)addressesOfHost:(NSString *)host error:(NSError **)error {
+    struct in_addr addr;
+    
+    if (inet_pton(AF_INET, host.UTF8String, &addr) == 1) {
+        return @[@(addr.s_addr)];
+    }
+    
+    NSTimeInterval timeToLive = self.timeToLive;
+    NSString *key = host.lowercaseString;
+    
+    @synchronized (self) {
+        SMBResolverEntry *entry = _entries[key];
+        
+        if (entry && -entry.time.timeIntervalSinceNow < timeToLive) {
+            return [entry.addresses copy];
+        }
+    }
+    
+    NSMutableArray<NSNumber *> *addresses = nil;
+    NSError *err = nil;
+    struct addrinfo hints;
+    struct addrinfo *result = NULL;
+    
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    
+    // Unlike gethostbyname, getaddrinfo is safe to call from several sessions at once
+    if (getaddrinfo(host.UTF8String, NULL, &hints, &result) == 0) {
+        addresses = [NSMutableArray array];
+        
+        for (struct addrinfo *info = result; info; info = info->ai_next) {
+            NSNumber *address = @(((struct sockaddr_in *)info->ai_addr)->sin_addr.s_addr);
+            
+            if (![addresses containsObject:address]) {
+                [addresses addObject:address];
+            }
+        }
+        
+        freeaddrinfo(result);
+        
+        if (addresses.count == 0) {
+            addresses = nil;
+            err = [SMBError noIPAddressError];
+        }
+    } else {
+        err = [SMBError hostNotFoundError];
+    }
+    
+    if (addresses && timeToLive > 0) {
+        @synchronized (self) {
+            SMBResolverEntry *entry = [SMBResolverEntry new];
+            
+            entry.addresses = [addresses mutableCopy];
+            entry.time = [NSDate new];
+            _entries[key] = entry;
+        }
+    }
+    
+    if (error) {
+        *error = err;
+    }
+    
+    return addresses;
+}
+
+- (void)addAddress:(in_addr_t)address forHost:(NSString *)host {
+    NSString *key = host.lowercaseString;
+    
+    @synchronized (self) {
+        SMBResolverEntry *entry = _entries[key];
+        
+        if (entry == nil) {
+            entry = [SMBResolverEntry new];
+            entry.addresses = [NSMutableArray array];
+            _entries[key] = entry;
+        }
+        
+        [entry.addresses removeObject:@(address)];
+        [entry.addresses insertObject:@(address) atIndex:0];
+        entry.time = [NSDate distantFuture];
+    }
+}
+
+- (void)preferAddress:(in_addr_t)address forHost:(NSString *)host {
+    @synchronized (self) {
+        SMBResolverEntry *entry = _entries[host.lowercaseString];
+        
+        if ([entry.addresses containsObject:@(address)]) {
+            [entry.addresses removeObject:@(address)];
+            [entry.addresses insertObject:@(address) atIndex:0];
+            entry.verifiedAddress = @(address);
+            entry.verifiedTime = [NSDate new];
+        }
+    }
+}
+
+- (NSNumber *)verifiedAddressOfHost:(NSString *)host {
+    NSTimeInterval timeToLive = self.timeToLive;
+    
+    @synchronized (self) {
+        SMBResolverEntry *entry = _entries[host.lowercaseString];
+        
+        if (entry.verifiedAddress && -entry.verifiedTime.timeIntervalSinceNow < timeToLive) {
+            return entry.verifiedAddress;
+        }
+        return nil;
+    }
+}
+
+- (void)removeAddressesOfHost:(NSString *)host {
+    @synchronized (self) {
+        [_entries removeObjectForKey:host.lowercaseString];
+    }
+}
+
+- (void)removeAllAddresses {
+    @synchronized (self) {
+        [_entries removeAllObjects];
+    }
+}
+
+- (in_addr_t)reachableAddress:(NSArray<NSNumber *> *)addresses port:(in_port_t)port timeout:(NSTimeInterval)timeout {
+    NSUInteger count = MIN(addresses.count, SMBResolverMaxAttempts);
+    in_addr_t reachable = addresses.firstObject.unsignedIntValue;
+    
+    if (count < 2) {
+        return reachable;
+    }
+    
+    struct pollfd fds[SMBResolverMaxAttempts];
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    NSTimeInterval nextAttempt = 0;
+    NSUInteger started = 0;
+    NSUInteger pending = 0;
+    BOOL found = NO;
+    
+    while (!found) {
+        NSTimeInterval elapsed = CFAbsoluteTimeGetCurrent() - start;
+        
+        if (elapsed >= timeout) {
+            break;
+        }
+        
+        if (started < count && (pending == 0 || elapsed >= nextAttempt)) {
+            fds[started].fd = [self _connect:addresses[started].unsignedIntValue port:port];
+            fds[started].events = POLLOUT;
+            fds[started].revents = 0;
+            
+            if (fds[started].fd >= 0) {
+                pending++;
+            }
+            
+            started++;
+            nextAttempt = elapsed + SMBResolverAttemptDelay;
+            continue;
+        }
+        
+        if (pending == 0) {
+            break;
+        }
+        
+        NSTimeInterval wait = timeout - elapsed;
+        
+        if (started < count) {
+            wait = MIN(wait, nextAttempt - elapsed);
+        }
+        
+        if (poll(fds, (nfds_t)started, (int)ceil(wait * 1000)) < 0 && errno != EINTR) {
+            break;
+        }
+        
+        for (NSUInteger i = 0; i < started; i++) {
+            if (fds[i].fd < 0 || fds[i].revents == 0) {
+                continue;
+            }
+            
+            int err = 0;
+            socklen_t length = sizeof(err);
+            
+            if ((fds[i].revents & POLLOUT) && getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &err, &length) == 0 && err == 0) {
+                reachable = addresses[i].unsignedIntValue;
+                found = YES;
+                break;
+            }
+            
+            // Try the next address right away
+            close(fds[i].fd);
+            fds[i].fd = -1;
+            pending--;
+            nextAttempt = 0;
+        }
+    }
+    
+    for (NSUInteger i = 0; i < started; i++) {
+        if (fds[i].fd >= 0) {
+            close(fds[i].fd);
+        }
+    }
+    
+    return reachable;
+}
+
+#pragma mark - Private methods
+
+// Starts a non-blocking connect, returns the socket or -1 if it failed right away
+- (int)_connect:(in_addr_t)address port:(in_port_t)port {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    
+    if (fd < 0) {
+        return -1;
+    }
+    
+    struct sockaddr_in addr;
+    int on = 1;
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_len = sizeof(addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = address;
+    
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    
+    return fd;
+}
+
+@end
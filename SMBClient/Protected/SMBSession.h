@@ -0,0 +1,82 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <Foundation/Foundation.h>
+
+#import "smb_session.h"
+
+@class SMBFileServer;
+
+// One authenticated smb_session of a file server together with the queue that
+// serializes all requests on it and the tree IDs of the shares connected on it.
+@interface SMBSession : NSObject
+
+@property (nonatomic, readonly, nonnull) dispatch_queue_t queue;
+@property (nonatomic, readonly, nullable) smb_session *smbSession;
+@property (atomic, readonly) NSUInteger pendingOperations;
+// Incremented whenever the session is replaced by a new one after it was lost.
+// File handles and tree IDs of an earlier generation are no longer valid.
+@property (atomic, readonly) NSUInteger generation;
+// Files opened on the session and not yet closed. Their handles would go along
+// with the session, so it isn't left to the session registry while there are any.
+@property (atomic, readonly) NSUInteger openFiles;
+
+// Wraps a session the server keeps ownership of
+- (nullable instancetype)initWithSession:(nonnull smb_session *)session queue:(nonnull dispatch_queue_t)queue server:(nonnull SMBFileServer *)server;
+// Creates a session of the server on first use
+- (nullable instancetype)initWithServer:(nonnull SMBFileServer *)server;
+
+// Connects and disconnects the IPC$ tree, as libdsm has no echo request. Returns
+// 0 if the server answered, a libdsm error otherwise.
++ (int)probeSession:(nonnull smb_session *)session;
+// Called for failed requests. If `session` belongs to the block running on the
+// current queue, and the server dropped it or can't be reached, the session is
+// replaced before the next operation. If the request failed without a status,
+// the session is probed first.
++ (void)noteError:(int)dsmError session:(nullable smb_session *)session;
+
+- (void)perform:(nonnull void (^)(SMBSession *_Nonnull session))block;
+- (void)performAndWait:(nonnull void (^)(SMBSession *_Nonnull session))block;
+
+// The following methods must be called on the queue of the session
+- (smb_tid)shareIDForShare:(nonnull NSString *)name error:(NSError *_Nullable *_Nullable)error;
+- (void)setShareID:(smb_tid)shareID forShare:(nonnull NSString *)name;
+- (nonnull NSDictionary<NSString *, NSNumber *> *)shareIDs;
+- (nullable NSError *)disconnectShare:(nonnull NSString *)name;
+- (void)addOpenFile;
+- (void)removeOpenFile;
+// Checks that the server still answers if the session has been idle for the keep
+// alive interval of the server, and marks it lost if it doesn't. Lost sessions are
+// reconnected right away, or before their next operation, if the server
+// reconnects automatically.
+- (void)keepAlive;
+// Leaves owned sessions without open files to the session registry of the server
+- (void)close;
+
+#pragma mark - Unavailable methods
+
++ new NS_UNAVAILABLE;
+- init NS_UNAVAILABLE;
+
+@end
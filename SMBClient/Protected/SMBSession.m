@@ -0,0 +1,317 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import "SMBSession.h"
+#import "SMBFileServer_Protected.h"
+#import "SMBError.h"
+#import "SMBMetricsRecorder.h"
+#import "SMBSessionRegistry.h"
+
+#import "smb_share.h"
+
+// NT_STATUS_USER_SESSION_DELETED, the server dropped the session, e.g. after a
+// restart
+static const uint32_t SMBSessionStatusDeleted = 0xC0000203;
+
+// The session whose block runs on the current thread, to which failed requests
+// are attributed
+static __thread __unsafe_unretained SMBSession *SMBCurrentSession = nil;
+
+@interface SMBSession ()
+
+@property (nonatomic, weak) SMBFileServer *server;
+@property (atomic) NSUInteger pendingOperations;
+@property (atomic) NSUInteger generation;
+@property (atomic) NSUInteger openFiles;
+
+@end
+
+@implementation SMBSession {
+    NSMutableDictionary<NSString *, NSNumber *> *_shareIDs;
+    BOOL _owned;
+    CFAbsoluteTime _lastActivity;
+    NSString *_sessionKey;
+    // Set when a request found the session dropped or the server unreachable, and
+    // when one failed without a status, which leaves it to a probe to tell
+    BOOL _lost;
+    BOOL _suspect;
+}
+
+- (instancetype)initWithSession:(smb_session *)session queue:(dispatch_queue_t)queue server:(SMBFileServer *)server {
+    self = [super init];
+    if (self) {
+        _smbSession = session;
+        _server = server;
+        _queue = queue;
+        _shareIDs = [NSMutableDictionary dictionary];
+        _owned = NO;
+        _lastActivity = CFAbsoluteTimeGetCurrent();
+    }
+    return self;
+}
+
+- (instancetype)initWithServer:(SMBFileServer *)server {
+    self = [super init];
+    if (self) {
+        NSString *queueName = [NSString stringWithFormat:@"smb_session_queue_%@", server.host];
+        
+        _server = server;
+        _queue = dispatch_queue_create(queueName.UTF8String, DISPATCH_QUEUE_SERIAL);
+        _shareIDs = [NSMutableDictionary dictionary];
+        _owned = YES;
+        _lastActivity = CFAbsoluteTimeGetCurrent();
+        _sessionKey = server.sessionKey;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self _recycle];
+}
+
++ (int)probeSession:(smb_session *)session {
+    smb_tid tid = 0;
+    int dsm_error = smb_tree_connect(session, "IPC$", &tid);
+    
+    if (dsm_error == 0) {
+        smb_tree_disconnect(session, tid);
+    }
+    
+    return dsm_error;
+}
+
++ (void)noteError:(int)dsmError session:(smb_session *)session {
+    SMBSession *current = SMBCurrentSession;
+    
+    if (session == NULL || current == nil || current->_smbSession != session) {
+        return;
+    }
+    
+    if ([self _isLost:dsmError session:session]) {
+        current->_lost = YES;
+    } else if (dsmError == DSM_ERROR_GENERIC && smb_session_get_nt_status(session) == NT_STATUS_SUCCESS) {
+        // Reads and writes fail with -1 whatever went wrong, without a new status
+        // only if no answer came
+        current->_suspect = YES;
+    }
+}
+
+- (void)perform:(void (^)(SMBSession *))block {
+    @synchronized (self) {
+        self.pendingOperations++;
+    }
+    
+    dispatch_async(_queue, ^{
+        [self _run:block];
+        
+        @synchronized (self) {
+            self.pendingOperations--;
+        }
+    });
+}
+
+- (void)performAndWait:(void (^)(SMBSession *))block {
+    @synchronized (self) {
+        self.pendingOperations++;
+    }
+    
+    dispatch_sync(_queue, ^{
+        [self _run:block];
+    });
+    
+    @synchronized (self) {
+        self.pendingOperations--;
+    }
+}
+
+- (smb_tid)shareIDForShare:(NSString *)name error:(NSError **)error {
+    NSNumber *shareID = _shareIDs[name];
+    NSError *err = nil;
+    
+    if (shareID == nil) {
+        if (_smbSession) {
+            smb_tid tid = 0;
+            uint64_t start = [self.server.metricsRecorder begin:SMBOperationTreeConnect];
+            int dsm_error = smb_tree_connect(_smbSession, name.UTF8String, &tid);
+            
+            [self.server.metricsRecorder end:SMBOperationTreeConnect start:start result:dsm_error];
+            
+            if (dsm_error == 0) {
+                shareID = @(tid);
+                _shareIDs[name] = shareID;
+            } else {
+                err = [SMBError dsmError:dsm_error session:_smbSession];
+            }
+        } else {
+            err = [SMBError notConnectedError];
+        }
+    }
+    
+    if (error) {
+        *error = err;
+    }
+    
+    return shareID.unsignedShortValue;
+}
+
+- (void)setShareID:(smb_tid)shareID forShare:(NSString *)name {
+    _shareIDs[name] = @(shareID);
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)shareIDs {
+    return [_shareIDs copy];
+}
+
+- (NSError *)disconnectShare:(NSString *)name {
+    NSNumber *shareID = _shareIDs[name];
+    NSError *error = nil;
+    
+    if (shareID) {
+        if (_smbSession) {
+            int dsm_error = smb_tree_disconnect(_smbSession, shareID.unsignedShortValue);
+            
+            if (dsm_error != 0) {
+                error = [SMBError dsmError:dsm_error session:_smbSession];
+            }
+        }
+        [_shareIDs removeObjectForKey:name];
+    }
+    
+    return error;
+}
+
+- (void)addOpenFile {
+    self.openFiles++;
+}
+
+- (void)removeOpenFile {
+    if (self.openFiles > 0) {
+        self.openFiles--;
+    }
+}
+
+- (void)keepAlive {
+    NSTimeInterval interval = self.server.keepAliveInterval;
+    
+    if (interval > 0 && _smbSession && CFAbsoluteTimeGetCurrent() - _lastActivity >= interval) {
+        [self _probe];
+    }
+}
+
+- (void)close {
+    [self _recycle];
+    [_shareIDs removeAllObjects];
+    _smbSession = NULL;
+    _server = nil;
+}
+
+#pragma mark - Private methods
+
++ (BOOL)_isLost:(int)dsmError session:(smb_session *)session {
+    return dsmError == DSM_ERROR_NETWORK || (dsmError == DSM_ERROR_NT && smb_session_get_nt_status(session) == SMBSessionStatusDeleted);
+}
+
+- (void)_run:(void (^)(SMBSession *))block {
+    SMBSession *previous = SMBCurrentSession;
+    
+    [self _prepare];
+    
+    SMBCurrentSession = self;
+    block(self);
+    SMBCurrentSession = previous;
+    
+    if (!_lost && !_suspect) {
+        _lastActivity = CFAbsoluteTimeGetCurrent();
+    }
+}
+
+- (void)_prepare {
+    NSTimeInterval interval = self.server.keepAliveInterval;
+    
+    if (_smbSession == NULL && _server) {
+        _smbSession = [_server createSession:nil shareIDs:_shareIDs];
+    } else if (_smbSession && _lost) {
+        // An earlier request lost the session, busy sessions aren't kept alive
+        if (self.server.reconnectsAutomatically) {
+            [self _reconnect];
+        }
+    } else if (_smbSession && (_suspect || (interval > 0 && CFAbsoluteTimeGetCurrent() - _lastActivity >= 2 * interval))) {
+        // A request failed without a status, or keep alives were missed, e.g. while
+        // the app was suspended
+        [self _probe];
+    }
+}
+
+- (void)_probe {
+    int dsm_error = [SMBSession probeSession:_smbSession];
+    
+    _suspect = NO;
+    
+    if (dsm_error == 0) {
+        _lastActivity = CFAbsoluteTimeGetCurrent();
+    } else if ([SMBSession _isLost:dsm_error session:_smbSession]) {
+        _lost = YES;
+        
+        if (self.server.reconnectsAutomatically) {
+            [self _reconnect];
+        }
+    }
+}
+
+// Replaces the lost session by a new one. Trees are connected again when they
+// are used next, files reopen their handles when they see the new generation.
+- (void)_reconnect {
+    SMBFileServer *server = self.server;
+    smb_session *session = [server reconnectSession:nil];
+    
+    if (session == NULL) {
+        return;
+    }
+    
+    if (_owned) {
+        smb_session_destroy(_smbSession);
+    } else {
+        [server replaceSession:_smbSession with:session];
+    }
+    
+    _smbSession = session;
+    [_shareIDs removeAllObjects];
+    _lost = NO;
+    _suspect = NO;
+    _lastActivity = CFAbsoluteTimeGetCurrent();
+    self.generation++;
+}
+
+- (void)_recycle {
+    if (_owned && _smbSession) {
+        if (_sessionKey && self.openFiles == 0) {
+            [[SMBSessionRegistry sharedRegistry] addSession:_smbSession shareIDs:_shareIDs forKey:_sessionKey];
+        } else {
+            smb_session_destroy(_smbSession);
+        }
+        _smbSession = NULL;
+    }
+}
+
+@end
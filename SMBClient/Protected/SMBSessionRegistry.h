@@ -0,0 +1,52 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <Foundation/Foundation.h>
+
+#import "smb_session.h"
+
+// Authenticated sessions no longer needed by one file server, kept for a while so
+// any server for the same host and user can take them over instead of connecting
+// and logging in again. A session is used by one server at a time, as libdsm
+// sessions can't be shared. Trees still connected on a session go along with it.
+@interface SMBSessionRegistry : NSObject
+
+// The time idle sessions are kept. Defaults to 0, which destroys sessions right
+// away when they are added.
+@property (atomic) NSTimeInterval idleTimeout;
+// The number of idle sessions kept per key. Defaults to 4.
+@property (atomic) NSUInteger maxIdleSessions;
+
++ (nonnull instancetype)sharedRegistry;
+
+// The key identifies the host and credentials a session was authenticated with
++ (nonnull NSString *)keyForHost:(nonnull NSString *)host domain:(nonnull NSString *)domain username:(nonnull NSString *)username password:(nonnull NSString *)password;
+
+// Removes the most recently added session of the key, the caller owns it
+- (nullable smb_session *)takeSessionForKey:(nonnull NSString *)key shareIDs:(NSDictionary<NSString *, NSNumber *> *_Nullable *_Nullable)shareIDs;
+// Takes ownership of the session
+- (void)addSession:(nonnull smb_session *)session shareIDs:(nullable NSDictionary<NSString *, NSNumber *> *)shareIDs forKey:(nonnull NSString *)key;
+- (void)removeAllSessions;
+
+@end
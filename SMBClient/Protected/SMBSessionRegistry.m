@@ -0,0 +1,214 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import "SMBSessionRegistry.h"
+
+#import <CommonCrypto/CommonDigest.h>
+
+@interface SMBIdleSession : NSObject
+
+@property (nonatomic, assign) smb_session *session;
+@property (nonatomic) NSDictionary<NSString *, NSNumber *> *shareIDs;
+@property (nonatomic) CFAbsoluteTime time;
+
+@end
+
+@implementation SMBIdleSession
+@end
+
+@implementation SMBSessionRegistry {
+    NSMutableDictionary<NSString *, NSMutableArray<SMBIdleSession *> *> *_sessions;
+    dispatch_queue_t _queue;
+    BOOL _evictionScheduled;
+}
+
++ (instancetype)sharedRegistry {
+    static dispatch_once_t pred = 0;
+    __strong static id _sharedObject = nil;
+    dispatch_once(&pred, ^{
+        _sharedObject = [[self alloc] init];
+    });
+    return _sharedObject;
+}
+
++ (NSString *)keyForHost:(NSString *)host domain:(NSString *)domain username:(NSString *)username password:(NSString *)password {
+    NSString *string = [NSString stringWithFormat:@"%@\n%@\n%@\n%@", host.lowercaseString, domain.lowercaseString, username, password];
+    NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding];
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    NSMutableString *key = [NSMutableString stringWithCapacity:CC_SHA256_DIGEST_LENGTH * 2];
+    
+    // Keeps the password out of the key
+    CC_SHA256(data.bytes, (CC_LONG)data.length, digest);
+    
+    for (NSUInteger i = 0; i < CC_SHA256_DIGEST_LENGTH; i++) {
+        [key appendFormat:@"%02x", digest[i]];
+    }
+    
+    return key;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _sessions = [NSMutableDictionary dictionary];
+        _queue = dispatch_queue_create("smb_session_registry_queue", DISPATCH_QUEUE_SERIAL);
+        _maxIdleSessions = 4;
+    }
+    return self;
+}
+
+- (smb_session *)takeSessionForKey:(NSString *)key shareIDs:(NSDictionary<NSString *, NSNumber *> **)shareIDs {
+    SMBIdleSession *idleSession = nil;
+    
+    [self _evict];
+    
+    @synchronized (self) {
+        NSMutableArray<SMBIdleSession *> *sessions = _sessions[key];
+        
+        idleSession = sessions.lastObject;
+        
+        if (idleSession) {
+            [sessions removeLastObject];
+        }
+    }
+    
+    if (shareIDs) {
+        *shareIDs = idleSession.shareIDs;
+    }
+    
+    return idleSession.session;
+}
+
+- (void)addSession:(smb_session *)session shareIDs:(NSDictionary<NSString *, NSNumber *> *)shareIDs forKey:(NSString *)key {
+    NSTimeInterval idleTimeout = self.idleTimeout;
+    smb_session *evicted = NULL;
+    
+    if (idleTimeout <= 0) {
+        smb_session_destroy(session);
+        return;
+    }
+    
+    SMBIdleSession *idleSession = [SMBIdleSession new];
+    
+    idleSession.session = session;
+    idleSession.shareIDs = [shareIDs copy];
+    idleSession.time = CFAbsoluteTimeGetCurrent();
+    
+    @synchronized (self) {
+        NSMutableArray<SMBIdleSession *> *sessions = _sessions[key];
+        
+        if (sessions == nil) {
+            sessions = [NSMutableArray array];
+            _sessions[key] = sessions;
+        }
+        
+        [sessions addObject:idleSession];
+        
+        if (sessions.count > self.maxIdleSessions) {
+            evicted = sessions.firstObject.session;
+            [sessions removeObjectAtIndex:0];
+        }
+    }
+    
+    if (evicted) {
+        smb_session_destroy(evicted);
+    }
+    
+    [self _scheduleEviction:idleTimeout];
+}
+
+- (void)removeAllSessions {
+    NSArray<NSArray<SMBIdleSession *> *> *sessions;
+    
+    @synchronized (self) {
+        sessions = _sessions.allValues;
+        [_sessions removeAllObjects];
+    }
+    
+    for (NSArray<SMBIdleSession *> *s in sessions) {
+        for (SMBIdleSession *idleSession in s) {
+            smb_session_destroy(idleSession.session);
+        }
+    }
+}
+
+#pragma mark - Private methods
+
+// Destroys the sessions idle for longer than the timeout
+- (void)_evict {
+    NSMutableArray<SMBIdleSession *> *evicted = [NSMutableArray array];
+    CFAbsoluteTime limit = CFAbsoluteTimeGetCurrent() - self.idleTimeout;
+    
+    @synchronized (self) {
+        for (NSString *key in _sessions.allKeys) {
+            NSMutableArray<SMBIdleSession *> *sessions = _sessions[key];
+            
+            // Sessions are ordered by the time they were added
+            while (sessions.count > 0 && sessions.firstObject.time <= limit) {
+                [evicted addObject:sessions.firstObject];
+                [sessions removeObjectAtIndex:0];
+            }
+            
+            if (sessions.count == 0) {
+                [_sessions removeObjectForKey:key];
+            }
+        }
+    }
+    
+    for (SMBIdleSession *idleSession in evicted) {
+        smb_session_destroy(idleSession.session);
+    }
+}
+
+- (void)_scheduleEviction:(NSTimeInterval)delay {
+    @synchronized (self) {
+        if (_evictionScheduled) {
+            return;
+        }
+        _evictionScheduled = YES;
+    }
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), _queue, ^{
+        CFAbsoluteTime oldest = 0;
+        
+        [self _evict];
+        
+        @synchronized (self) {
+            self->_evictionScheduled = NO;
+            
+            for (NSArray<SMBIdleSession *> *sessions in self->_sessions.allValues) {
+                if (oldest == 0 || sessions.firstObject.time < oldest) {
+                    oldest = sessions.firstObject.time;
+                }
+            }
+        }
+        
+        // Wake up again when the oldest remaining session expires
+        if (oldest > 0) {
+            [self _scheduleEviction:MAX(oldest + self.idleTimeout - CFAbsoluteTimeGetCurrent(), 1)];
+        }
+    });
+}
+
+@end
@@ -28,6 +28,10 @@
 
 #import "smb_session.h"
 
+@class SMBSession;
+@class SMBContentCache;
+@class SMBMetricsRecorder;
+
 @interface SMBStat : NSObject
 
 @property (nonatomic, readonly) BOOL exists;
@@ -39,6 +43,9 @@
 @property (nonatomic, readonly, nullable) NSDate *writeTime;
 @property (nonatomic, readonly, nullable) NSDate *statTime;
 @property (nonatomic, readonly, nullable) NSString *smbName;
+// The raw timestamps as reported by the server
+@property (nonatomic, readonly) uint64_t modificationTimestamp;
+@property (nonatomic, readonly) uint64_t writeTimestamp;
 
 + (nullable instancetype)statForNonExistingFile;
 + (nullable instancetype)statForRoot;
@@ -59,13 +66,32 @@
 
 - (nullable instancetype)initWithName:(nonnull NSString *)name server:(nonnull SMBFileServer *)server;
 
+@property (nonatomic, readonly, nonnull) SMBContentCache *contentCache;
+@property (nonatomic, readonly, nonnull) SMBMetricsRecorder *metricsRecorder;
+
+// Calls the block where completions of this share and its files go
+- (void)dispatchCompletion:(nonnull dispatch_block_t)block;
+// Called when the server disconnects, which closes the share for all its users
+- (void)resetAfterDisconnect;
+
 - (void)listFiles:(nonnull NSString *)path filter:(nullable BOOL (^)(SMBFile *_Nonnull file))filter completion:(nullable void (^)(NSArray<SMBFile *> *_Nullable files, NSError *_Nullable error))completion;
+- (void)listFiles:(nonnull NSString *)path batchSize:(NSUInteger)batchSize filter:(nullable BOOL (^)(SMBFile *_Nonnull file))filter progress:(nullable BOOL (^)(NSArray<SMBFile *> *_Nullable files, BOOL complete, NSError *_Nullable error))progress;
+- (void)listFilesRecursively:(nonnull NSString *)path concurrency:(NSUInteger)concurrency filter:(nullable BOOL (^)(SMBFile *_Nonnull file))filter progress:(nullable BOOL (^)(NSArray<SMBFile *> *_Nullable files, BOOL complete, NSError *_Nullable error))progress;
+- (void)deleteRecursively:(nonnull NSString *)path concurrency:(NSUInteger)concurrency progress:(nullable BOOL (^)(NSUInteger filesDeleted, unsigned long long bytesDeleted, BOOL complete, NSError *_Nullable error))progress;
+- (void)downloadDirectory:(nonnull NSString *)path to:(nonnull NSString *)localPath concurrency:(NSUInteger)concurrency progress:(nullable BOOL (^)(NSUInteger filesDownloaded, unsigned long long bytesDownloaded, BOOL complete, NSError *_Nullable error))progress;
+- (void)uploadDirectory:(nonnull NSString *)localPath to:(nonnull NSString *)path concurrency:(NSUInteger)concurrency progress:(nullable BOOL (^)(NSUInteger filesUploaded, unsigned long long bytesUploaded, BOOL complete, NSError *_Nullable error))progress;
+- (void)resumableDownload:(nonnull NSString *)path to:(nonnull NSString *)localPath progress:(nullable BOOL (^)(unsigned long long bytesTotal, BOOL complete, NSError *_Nullable error))progress;
+- (void)resumableUpload:(nonnull NSString *)localPath to:(nonnull NSString *)path progress:(nullable BOOL (^)(unsigned long long bytesTotal, BOOL complete, NSError *_Nullable error))progress;
 - (void)getStatusOfFile:(nonnull NSString *)path completion:(nullable void (^)(SMBStat *_Nullable status, NSError *_Nullable error))completion;
 - (void)createDirectory:(nonnull NSString *)path completion:(nullable void (^)(SMBFile *_Nullable file, NSError *_Nullable error))completion;
 - (void)createDirectories:(nonnull NSString *)path completion:(nullable void (^)(SMBFile *_Nullable file, NSError *_Nullable error))completion;
 - (void)moveFile:(nonnull NSString *)oldPath to:(nonnull NSString *)newPath completion:(nullable void (^)(SMBFile *_Nullable file, NSError *_Nullable error))completion;
 - (void)deleteFile:(nonnull NSString *)path completion:(nullable void (^)(NSError *_Nullable error))completion;
-- (void)openFile:(nonnull NSString *)path mode:(SMBFileMode)mode completion:(nullable void (^)(SMBFile *_Nullable file, smb_fd fd, NSError *_Nullable error))completion;
-- (void)closeFile:(smb_fd)fd path:(nonnull NSString *)path completion:(nullable void (^)(SMBFile *_Nullable file, NSError *_Nullable error))completion;
+// Opening and closing files is recorded in the given recorder, that of the file
+- (void)openFile:(nonnull NSString *)path mode:(SMBFileMode)mode metricsRecorder:(nonnull SMBMetricsRecorder *)metricsRecorder completion:(nullable void (^)(SMBFile *_Nullable file, SMBSession *_Nullable session, smb_fd fd, NSError *_Nullable error))completion;
+// Opens a file again after its session was replaced. Must be called on the queue
+// of the session, returns 0 on failure, after which the file counts as closed.
+- (smb_fd)reopenFile:(nonnull NSString *)path mode:(SMBFileMode)mode session:(nonnull SMBSession *)session metricsRecorder:(nonnull SMBMetricsRecorder *)metricsRecorder error:(NSError *_Nullable *_Nullable)error;
+- (void)closeFile:(smb_fd)fd path:(nonnull NSString *)path mode:(SMBFileMode)mode session:(nonnull SMBSession *)session generation:(NSUInteger)sessionGeneration metricsRecorder:(nonnull SMBMetricsRecorder *)metricsRecorder completion:(nullable void (^)(SMBFile *_Nullable file, NSError *_Nullable error))completion;
 
 @end
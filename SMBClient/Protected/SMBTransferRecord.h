@@ -0,0 +1,48 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <Foundation/Foundation.h>
+
+// Remembers how far a transfer between a remote and a local file got, along with
+// the size and timestamps its source had. The record is a property list in the
+// caches of the app.
+@interface SMBTransferRecord : NSObject
+
+- (nullable instancetype)initWithKey:(nonnull NSString *)key;
+
+// The offset recorded for the source, or 0 if the source has changed since or is
+// shorter than the offset in the target, whose size is given by limit. If the state
+// of the target was recorded too, it must still be the same.
+- (unsigned long long)offsetForSource:(nonnull NSDictionary *)source target:(nullable NSDictionary *)target limit:(unsigned long long)limit;
+- (void)setOffset:(unsigned long long)offset source:(nonnull NSDictionary *)source target:(nullable NSDictionary *)target;
+// Replaces the state of the target recorded with the offset, if there is a record
+- (void)setTarget:(nonnull NSDictionary *)target;
+- (void)remove;
+
+#pragma mark - Unavailable methods
+
++ new NS_UNAVAILABLE;
+- init NS_UNAVAILABLE;
+
+@end
@@ -0,0 +1,91 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import "SMBTransferRecord.h"
+
+#import <CommonCrypto/CommonDigest.h>
+
+@implementation SMBTransferRecord {
+    NSString *_path;
+}
+
+- (instancetype)initWithKey:(NSString *)key {
+    self = [super init];
+    if (self) {
+        NSString *caches = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject ?: NSTemporaryDirectory();
+        NSData *data = [key dataUsingEncoding:NSUTF8StringEncoding];
+        unsigned char digest[CC_SHA1_DIGEST_LENGTH];
+        NSMutableString *name = [NSMutableString stringWithCapacity:CC_SHA1_DIGEST_LENGTH * 2 + 6];
+        
+        CC_SHA1(data.bytes, (CC_LONG)data.length, digest);
+        
+        for (NSUInteger i = 0; i < CC_SHA1_DIGEST_LENGTH; i++) {
+            [name appendFormat:@"%02x", digest[i]];
+        }
+        [name appendString:@".plist"];
+        
+        _path = [[[caches stringByAppendingPathComponent:@"SMBClient"] stringByAppendingPathComponent:@"Transfers"] stringByAppendingPathComponent:name];
+    }
+    return self;
+}
+
+- (unsigned long long)offsetForSource:(NSDictionary *)source target:(NSDictionary *)target limit:(unsigned long long)limit {
+    NSDictionary *record = [NSDictionary dictionaryWithContentsOfFile:_path];
+    unsigned long long offset = [record[@"offset"] unsignedLongLongValue];
+    
+    if (![record[@"source"] isEqual:source] || offset > limit) {
+        return 0;
+    }
+    
+    // Someone else may have written to the target in the meantime
+    if (target && record[@"target"] && ![record[@"target"] isEqual:target]) {
+        return 0;
+    }
+    
+    return offset;
+}
+
+- (void)setOffset:(unsigned long long)offset source:(NSDictionary *)source target:(NSDictionary *)target {
+    NSMutableDictionary *record = [NSMutableDictionary dictionaryWithDictionary:@{@"offset": @(offset), @"source": source}];
+    
+    record[@"target"] = target;
+    
+    [[NSFileManager defaultManager] createDirectoryAtPath:[_path stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:nil];
+    [record writeToFile:_path atomically:YES];
+}
+
+- (void)setTarget:(NSDictionary *)target {
+    NSMutableDictionary *record = [NSMutableDictionary dictionaryWithContentsOfFile:_path];
+    
+    if (record) {
+        record[@"target"] = target;
+        [record writeToFile:_path atomically:YES];
+    }
+}
+
+- (void)remove {
+    [[NSFileManager defaultManager] removeItemAtPath:_path error:nil];
+}
+
+@end
@@ -35,4 +35,5 @@ FOUNDATION_EXPORT const unsigned char SMBClientVersionString[];
 #import <SMBClient/SMBFileServer.h>
 #import <SMBClient/SMBShare.h>
 #import <SMBClient/SMBFile.h>
+#import <SMBClient/SMBMetrics.h>
 
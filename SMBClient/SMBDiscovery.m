@@ -24,6 +24,7 @@
 
 #import "SMBDiscovery.h"
 #import "SMBFileServer.h"
+#import "SMBResolver.h"
 #import "netbios_ns.h"
 #import "netbios_defs.h"
 
@@ -114,6 +115,13 @@ static SMBDevice *_device(netbios_ns_entry *entry) {
 }
 
 static void _on_entry_added(void *p_opaque, netbios_ns_entry *entry) {
+    const char *n = netbios_ns_entry_name(entry);
+    
+    // Connecting by NetBIOS name doesn't need to ask DNS anymore
+    if (n && n[0]) {
+        [[SMBResolver sharedResolver] addAddress:netbios_ns_entry_ip(entry) forHost:[NSString stringWithUTF8String:n]];
+    }
+    
     dispatch_async(dispatch_get_main_queue(), ^{
         if (_addedHandler) {
             SMBDevice *device = _device(entry);
@@ -126,6 +134,12 @@ static void _on_entry_added(void *p_opaque, netbios_ns_entry *entry) {
 }
 
 static void _on_entry_removed(void *p_opaque, netbios_ns_entry *entry) {
+    const char *n = netbios_ns_entry_name(entry);
+    
+    if (n && n[0]) {
+        [[SMBResolver sharedResolver] removeAddressesOfHost:[NSString stringWithUTF8String:n]];
+    }
+    
     dispatch_async(dispatch_get_main_queue(), ^{
         if (_removedHandler) {
             SMBDevice *device = _device(entry);
@@ -25,6 +25,7 @@
 #import <Foundation/Foundation.h>
 
 @class SMBShare;
+@class SMBMetrics;
 
 @interface SMBFile : NSObject
 
@@ -41,6 +42,8 @@ typedef NS_OPTIONS(NSUInteger, SMBFileMode) {
 @property (nonatomic, readonly) BOOL exists;
 @property (nonatomic, readonly) BOOL isDirectory;
 @property (nonatomic, readonly) unsigned long long size;
+// These four are nil without a status, and also if the server reports a time of 0,
+// which it does for times it doesn't keep, rather than January 1, 1601
 @property (nonatomic, readonly, nullable) NSDate *creationTime;
 @property (nonatomic, readonly, nullable) NSDate *modificationTime;
 @property (nonatomic, readonly, nullable) NSDate *accessTime;
@@ -49,6 +52,12 @@ typedef NS_OPTIONS(NSUInteger, SMBFileMode) {
 @property (nonatomic, readonly) BOOL hasStatus;
 @property (nonatomic, readonly, nullable) SMBFile *parent;
 @property (nonatomic, readonly) BOOL isOpen;
+// Limited reads of a file opened for reading only are served from a cache of up to
+// this many bytes, which is filled in aligned blocks and read ahead while the file
+// is read sequentially. 0, the default, disables the cache.
+@property (nonatomic) NSUInteger blockCacheSize;
+// Latencies, queue waits and bytes transferred of this file
+@property (nonatomic, readonly, nonnull) SMBMetrics *metrics;
 
 + (nullable instancetype)rootOfShare:(nonnull SMBShare *)share;
 + (nullable instancetype)fileWithPath:(nonnull NSString *)path share:(nonnull SMBShare *)share;
@@ -61,17 +70,79 @@ typedef NS_OPTIONS(NSUInteger, SMBFileMode) {
 - (void)close:(nullable void (^)(NSError *_Nullable error))completion;
 //- (void)write:(nonnull NSData *)data completion:(nullable void (^)(long bytesWritten, NSError *_Nullable error))completion;
 - (void)write:(nonnull NSData *_Nullable (^)(unsigned long long))dataHandler progress:(nullable void (^)(unsigned long long bytesWrittenTotal, long bytesWrittenLast, BOOL complete, NSError *_Nullable error))progress;
+// Collects the data of `dataHandler` into writes of `bufferSize` bytes and keeps up to
+// `window` of them in flight, each additional one on its own session. Progress is
+// reported for the bytes the server has acknowledged without a gap from the start,
+// and the file is left right after them.
+- (void)write:(nonnull NSData *_Nullable (^)(unsigned long long))dataHandler bufferSize:(NSUInteger)bufferSize window:(NSUInteger)window progress:(nullable void (^)(unsigned long long bytesWrittenTotal, long bytesWrittenLast, BOOL complete, NSError *_Nullable error))progress;
 - (void)read:(NSUInteger)bufferSize progress:(nullable BOOL (^)(unsigned long long bytesReadTotal, NSData *_Nullable data, BOOL complete, NSError *_Nullable error))progress;
+// Reads at most `maxBytes` bytes, or up to the end of the file if 0. No more than a
+// few chunks wait for `progress` at any time, and the session is free for other
+// operations while they do.
 - (void)read:(NSUInteger)bufferSize maxBytes:(unsigned long long)maxBytes progress:(nullable BOOL (^)(unsigned long long bytesReadTotal, NSData *_Nullable data, BOOL complete, NSError *_Nullable error))progress;
+// Keeps up to `window` reads of `bufferSize` bytes in flight at consecutive offsets,
+// each on its own session, and delivers the chunks to `progress` in file order.
+// A window of 0 or 1 is equivalent to read:maxBytes:progress:.
+//
+// The additional sessions of this, the windowed write and the segmented download
+// are kept by the server for a minute afterwards, for the next such transfer.
+// Otherwise they cost a connect and login each, more round trips than a window
+// saves on small files.
+- (void)read:(NSUInteger)bufferSize maxBytes:(unsigned long long)maxBytes window:(NSUInteger)window progress:(nullable BOOL (^)(unsigned long long bytesReadTotal, NSData *_Nullable data, BOOL complete, NSError *_Nullable error))progress;
+// Reads directly into buffers owned by the caller. `bufferProvider` is called on the
+// worker queue before each read and returns a buffer of `*length` bytes, or NULL to
+// stop. Every buffer is passed to `progress` and handed back to the caller when it
+// returns, with a length of 0 if nothing was read into it.
+- (void)readIntoBuffers:(nonnull void *_Nullable (^)(NSUInteger *_Nonnull length))bufferProvider maxBytes:(unsigned long long)maxBytes progress:(nullable BOOL (^)(unsigned long long bytesReadTotal, void *_Nullable buffer, NSUInteger length, BOOL complete, NSError *_Nullable error))progress;
+// Splits the file into `segments` byte ranges, which are read concurrently, each on
+// its own session, and written to `localPath`. The position of the file stays
+// unchanged. Fails if the file turns out to be shorter than its status told.
+- (void)downloadTo:(nonnull NSString *)localPath segments:(NSUInteger)segments progress:(nullable BOOL (^)(unsigned long long bytesReadTotal, BOOL complete, NSError *_Nullable error))progress;
 - (void)seek:(unsigned long long)offset absolute:(BOOL)absolute completion:(nullable void (^)(unsigned long long position, NSError *_Nullable error))completion;
+// Read and write at the given offset and leave the position of the file, that read,
+// write and seek work with, unchanged. So they can be issued from anywhere without
+// coordinating with other users of the file. Fewer bytes than requested are only
+// read at the end of the file.
+- (void)readAtOffset:(unsigned long long)offset length:(NSUInteger)length completion:(nullable void (^)(NSData *_Nullable data, NSError *_Nullable error))completion;
+- (void)writeAtOffset:(unsigned long long)offset data:(nonnull NSData *)data completion:(nullable void (^)(NSUInteger bytesWritten, NSError *_Nullable error))completion;
 
 - (void)listFiles:(nullable void (^)(NSArray<SMBFile *> *_Nullable files, NSError *_Nullable error))completion;
 - (void)listFilesUsingFilter:(nullable BOOL (^)(SMBFile *_Nonnull file))filter completion:(nullable void (^)(NSArray<SMBFile *> *_Nullable files, NSError *_Nullable error))completion;
+// Lists the directory in batches of up to `batchSize` files. Only a few batches
+// are held back while `progress` is busy. Return NO from `progress` to stop early.
+// `progress` is called with `complete` set exactly once, even after stopping early.
+- (void)listFiles:(NSUInteger)batchSize filter:(nullable BOOL (^)(SMBFile *_Nonnull file))filter progress:(nullable BOOL (^)(NSArray<SMBFile *> *_Nullable files, BOOL complete, NSError *_Nullable error))progress;
+// Lists all files below the directory, breadth first, with up to `concurrency`
+// directories searched at a time. `filter` selects the files reported. A directory
+// that can't be searched is skipped, and the error reported with `complete`.
+- (void)listFilesRecursively:(NSUInteger)concurrency filter:(nullable BOOL (^)(SMBFile *_Nonnull file))filter progress:(nullable BOOL (^)(NSArray<SMBFile *> *_Nullable files, BOOL complete, NSError *_Nullable error))progress;
 - (void)updateStatus:(nullable void (^)(NSError *_Nullable error))completion;
 - (void)createDirectory:(nullable void (^)(NSError *_Nullable error))completion;
 - (void)createDirectories:(nullable void (^)(NSError *_Nullable error))completion;
 - (void)delete:(nullable void (^)(NSError *_Nullable error))completion;
+// Deletes the file, or the directory with everything in it. Listings are reused, so
+// nothing is looked up twice, and up to `concurrency` deletions are in flight.
+// This one and the directory copies below call `progress` with `complete` set
+// exactly once, even after stopping early.
+- (void)deleteRecursively:(NSUInteger)concurrency progress:(nullable BOOL (^)(NSUInteger filesDeleted, unsigned long long bytesDeleted, BOOL complete, NSError *_Nullable error))progress;
+// Copies the directory with everything in it to `localPath`, up to `concurrency`
+// files at a time. Each of them needs a session of its own, so the concurrency
+// is also limited by maxSessions of the server, which is 1 unless raised. Fails
+// if the file isn't a directory. Files only appear under their name once they are
+// complete.
+- (void)downloadDirectoryTo:(nonnull NSString *)localPath concurrency:(NSUInteger)concurrency progress:(nullable BOOL (^)(NSUInteger filesDownloaded, unsigned long long bytesDownloaded, BOOL complete, NSError *_Nullable error))progress;
+// Copies the local directory at `localPath` with everything in it into this directory,
+// up to `concurrency` files at a time, as far as maxSessions allows. Existing files
+// are replaced.
+- (void)uploadDirectoryFrom:(nonnull NSString *)localPath concurrency:(NSUInteger)concurrency progress:(nullable BOOL (^)(NSUInteger filesUploaded, unsigned long long bytesUploaded, BOOL complete, NSError *_Nullable error))progress;
+// Copy the file to or from `localPath` and record how far they got. Called again
+// after they were interrupted, they continue from there, as long as the size and
+// modification time of the source haven't changed, nor for an upload those of the
+// file on the server. The file needn't be open.
+- (void)resumableDownloadTo:(nonnull NSString *)localPath progress:(nullable BOOL (^)(unsigned long long bytesTotal, BOOL complete, NSError *_Nullable error))progress;
+- (void)resumableUploadFrom:(nonnull NSString *)localPath progress:(nullable BOOL (^)(unsigned long long bytesTotal, BOOL complete, NSError *_Nullable error))progress;
 - (void)moveTo:(nonnull NSString *)path completion:(nullable void (^)(NSError *_Nullable error))completion;
+- (void)resetMetrics;
 
 #pragma mark - Unavailable methods
 
@@ -25,16 +25,52 @@
 #import "SMBFile_Protected.h"
 #import "SMBShare_Protected.h"
 #import "SMBError.h"
+#import "SMBBufferPool.h"
+#import "SMBSession.h"
+#import "SMBBlockCache.h"
+#import "SMBContentCache.h"
+#import "SMBMetricsRecorder.h"
 
 #import "smb_file.h"
+#import "smb_share.h"
+
+#import <fcntl.h>
+#import <unistd.h>
 
 @interface SMBFile ()
 
 @property (nonatomic) dispatch_queue_t serialQueue;
 @property (nonatomic) smb_fd fileID;
+@property (nonatomic) SMBSession *session;
+@property (nonatomic) SMBFileMode mode;
+// The generation of the session the handle belongs to and the position of the
+// handle after the last operation, to reopen the file after a reconnect
+@property (nonatomic) NSUInteger generation;
+@property (nonatomic) unsigned long long position;
+@property (atomic) SMBBlockCache *blockCache;
+@property (nonatomic) SMBMetricsRecorder *metricsRecorder;
+
+@end
+
+// A lane is a file handle with a queue of its own, on which the pipelined
+// read issues its requests. The first lane uses the handle of the file itself,
+// additional lanes open their own session.
+@interface SMBFileLane : NSObject
+
+@property (nonatomic, readonly) dispatch_queue_t queue;
+@property (nonatomic, readonly) smb_session *session;
+@property (nonatomic, readonly) smb_fd fileID;
+
+- (instancetype)initWithSession:(smb_session *)session fileID:(smb_fd)fileID owned:(BOOL)owned;
++ (instancetype)laneForFile:(SMBFile *)file mode:(uint32_t)mod;
+
+- (void)close;
 
 @end
 
+// The number of chunks a read hands over before it waits for the consumer
+static const NSUInteger SMBMaximumPendingChunks = 4;
+
 @implementation SMBFile
 
 + (instancetype)rootOfShare:(SMBShare *)share {
@@ -56,11 +92,8 @@
 - (instancetype)initWithPath:(NSString *)path share:(SMBShare *)share {
     self = [super init];
     if (self) {
-        NSString *queueName = [NSString stringWithFormat:@"smb_file_queue_%@", path];
-
         _path = path;
         _share = share;
-        _serialQueue = dispatch_queue_create(queueName.UTF8String, DISPATCH_QUEUE_SERIAL);
 
         if ([_path isEqualToString:@"/"]) {
             self.smbStat = [SMBStat statForRoot];
@@ -119,17 +152,22 @@
 
 - (void)open:(SMBFileMode)mode completion:(nullable void (^)(NSError *_Nullable))completion {
 
-    dispatch_async(_serialQueue, ^{
+    dispatch_async(self.serialQueue, ^{
     
-        [self.share openFile:self.path mode:mode completion:^(SMBFile *file, smb_fd fileID, NSError *error) {
+        [self.share openFile:self.path mode:mode metricsRecorder:self.metricsRecorder completion:^(SMBFile *file, SMBSession *session, smb_fd fileID, NSError *error) {
             if (error == nil) {
                 self->_fileID = fileID;
+                self->_session = session;
+                self->_mode = mode;
+                self->_generation = session.generation;
+                self->_position = 0;
                 self->_smbStat = file.smbStat;
+                
+                // The file may have changed since it was last open
+                [self.blockCache removeAllBlocks];
             }
             if (completion) {
-                dispatch_async(dispatch_get_main_queue(), ^{
-                    completion(error);
-                });
+                completion(error);
             }
         }];
     });
@@ -138,22 +176,25 @@
 
 - (void)close:(nullable void (^)(NSError *_Nullable))completion {
 
-    dispatch_async(_serialQueue, ^{
+    dispatch_async(self.serialQueue, ^{
 
         if (self->_fileID == 0) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion([SMBError notOpenError]);
-            });
+            if (completion) {
+                [self.share dispatchCompletion:^{
+                    completion([SMBError notOpenError]);
+                }];
+            }
         } else {
-            [self.share closeFile:self->_fileID path:self.path completion:^(SMBFile *file, NSError * _Nullable error) {
+            [self.share closeFile:self->_fileID path:self.path mode:self->_mode session:self->_session generation:self->_generation metricsRecorder:self.metricsRecorder completion:^(SMBFile *file, NSError * _Nullable error) {
                 if (error == nil) {
                     self->_fileID = 0;
+                    self->_session = nil;
                     self->_smbStat = file.smbStat;
+                    
+                    [self.blockCache removeAllBlocks];
                 }
                 if (completion) {
-                    dispatch_async(dispatch_get_main_queue(), ^{
-                        completion(error);
-                    });
+                    completion(error);
                 }
             }];
             
@@ -167,15 +208,15 @@
 
 - (void)seek:(unsigned long long)offset absolute:(BOOL)absolute completion:(nullable void (^)(unsigned long long, NSError *_Nullable))completion {
     
-    dispatch_async(_serialQueue, ^{
+    [self _perform:^(smb_session *session) {
         
         NSError *error = nil;
         unsigned long long position = 0;
 
-        if (self.share.server.smbSession) {
+        if (session) {
             if ([self isOpen]) {
                 
-                off_t pos = smb_fseek(self.share.server.smbSession, self->_fileID, offset, absolute ? SMB_SEEK_SET : SMB_SEEK_CUR);
+                off_t pos = smb_fseek(session, self->_fileID, offset, absolute ? SMB_SEEK_SET : SMB_SEEK_CUR);
                 
                 position = MAX(0L, pos);
                 
@@ -191,12 +232,104 @@
         }
         
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
+            [self.share dispatchCompletion:^{
                 completion(position, error);
-            });
+            }];
         }
 
-    });
+    }];
+}
+
+- (void)readAtOffset:(unsigned long long)offset length:(NSUInteger)length completion:(nullable void (^)(NSData *_Nullable, NSError *_Nullable))completion {
+    
+    [self _perform:^(smb_session *session) {
+        
+        NSError *error = nil;
+        NSData *data = nil;
+        
+        if (session) {
+            if ([self isOpen]) {
+                
+                ssize_t position = smb_fseek(session, self->_fileID, 0, SMB_SEEK_CUR);
+                SMBBlockCache *cache = [self _usableBlockCache];
+                
+                if (position < 0) {
+                    error = [SMBError seekError];
+                } else {
+                    if (cache) {
+                        data = [self _dataAtOffset:offset length:length cache:cache session:session error:&error];
+                        
+                        // The status may be outdated, what lies beyond its size is read
+                        // from the server
+                        if (data && data.length < length && offset + data.length >= self.size) {
+                            NSMutableData *combined = [data mutableCopy];
+                            NSData *rest = [self _dataAtOffset:offset + data.length length:length - data.length session:session error:&error];
+                            
+                            [combined appendData:rest];
+                            data = rest ? combined : nil;
+                        }
+                    } else {
+                        data = [self _dataAtOffset:offset length:length session:session error:&error];
+                    }
+                    
+                    smb_fseek(session, self->_fileID, position, SMB_SEEK_SET);
+                }
+            } else {
+                error = [SMBError notOpenError];
+            }
+        } else {
+            error = [SMBError notConnectedError];
+        }
+        
+        if (completion) {
+            [self.share dispatchCompletion:^{
+                completion(data, error);
+            }];
+        }
+    }];
+}
+
+- (void)writeAtOffset:(unsigned long long)offset data:(nonnull NSData *)data completion:(nullable void (^)(NSUInteger, NSError *_Nullable))completion {
+    
+    [self _perform:^(smb_session *session) {
+        
+        NSError *error = nil;
+        NSUInteger bytesWritten = 0;
+        
+        if (session) {
+            if ([self isOpen]) {
+                
+                ssize_t position = smb_fseek(session, self->_fileID, 0, SMB_SEEK_CUR);
+                
+                if (position < 0 || smb_fseek(session, self->_fileID, offset, SMB_SEEK_SET) < 0) {
+                    error = [SMBError seekError];
+                } else {
+                    // A single write may accept less than requested
+                    while (bytesWritten < data.length) {
+                        ssize_t result = [self.metricsRecorder write:session file:self->_fileID buffer:(char *)data.bytes + bytesWritten length:data.length - bytesWritten];
+                        
+                        if (result <= 0) {
+                            error = [SMBError writeError];
+                            break;
+                        }
+                        bytesWritten += result;
+                    }
+                    
+                    smb_fseek(session, self->_fileID, position, SMB_SEEK_SET);
+                }
+            } else {
+                error = [SMBError notOpenError];
+            }
+        } else {
+            error = [SMBError notConnectedError];
+        }
+        
+        if (completion) {
+            [self.share dispatchCompletion:^{
+                completion(bytesWritten, error);
+            }];
+        }
+    }];
 }
 
 - (void)read:(NSUInteger)bufferSize progress:(nullable BOOL (^)(unsigned long long, NSData *_Nullable, BOOL, NSError *_Nullable))progress {
@@ -205,31 +338,230 @@
 
 - (void)read:(NSUInteger)bufferSize maxBytes:(unsigned long long)maxBytes progress:(nullable BOOL (^)(unsigned long long, NSData *_Nullable, BOOL, NSError *_Nullable))progress {
     
-    dispatch_async(_serialQueue, ^{
+    uint64_t enqueued = [SMBMetricsRecorder now];
+    
+    // The session is only held for each read, not while waiting for the consumer
+    dispatch_async(self.serialQueue, ^{
         
-        NSError *error = nil;
-        __block BOOL finished = NO;
+        __block NSError *error = nil;
+        BOOL finished = NO;
+        __block BOOL stopped = NO;
+        __block unsigned long long bytesDelivered = 0;
         unsigned long long bytesReadTotal = 0;
+        __block ssize_t start = -1;
+        dispatch_semaphore_t pending = dispatch_semaphore_create(0);
+        NSObject *lock = [NSObject new];
         
-        if (self.share.server.smbSession) {
-            if ([self isOpen]) {
-                
-                char buf[bufferSize];
+        BOOL (^isStopped)(void) = ^BOOL{
+            @synchronized (lock) {
+                return stopped;
+            }
+        };
+        
+        for (NSUInteger i = 0; i < SMBMaximumPendingChunks; i++) {
+            dispatch_semaphore_signal(pending);
+        }
+        
+        // Hands a chunk to progress, after room was made for it. Once progress
+        // declined, no further chunk is handed over.
+        void (^deliver)(NSData *, unsigned long long) = ^(NSData *data, unsigned long long total) {
+            [self.share dispatchCompletion:^{
+                if (!isStopped()) {
+                    bytesDelivered = total;
+                    
+                    if (!progress(total, data, NO, nil)) {
+                        @synchronized (lock) {
+                            stopped = YES;
+                        }
+                    }
+                }
+                dispatch_semaphore_signal(pending);
+            }];
+        };
+        
+        [self _performNow:^(smb_session *session) {
+            if (session == NULL) {
+                error = [SMBError notConnectedError];
+            } else if (![self isOpen]) {
+                error = [SMBError notOpenError];
+            } else {
+                start = smb_fseek(session, self->_fileID, 0, SMB_SEEK_CUR);
+            }
+        } enqueued:enqueued];
+        
+        // Only limited reads go through the block cache. A complete read is served
+        // from the content cache, or fills it.
+        SMBBlockCache *cache = error == nil && maxBytes > 0 ? [self _usableBlockCache] : nil;
+        SMBContentCache *contentCache = error == nil && start == 0 && maxBytes == 0 ? [self _usableContentCache] : nil;
+        NSString *cachedPath = [contentCache pathOfFile:self.path status:self->_smbStat];
+        NSString *copyPath = cachedPath ? nil : [contentCache temporaryPath];
+        int cachedFile = cachedPath ? open(cachedPath.fileSystemRepresentation, O_RDONLY) : -1;
+        int copyFile = copyPath ? open(copyPath.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+        SMBBufferPool *pool = self.share.server.bufferPool;
+        NSUInteger size = MIN(bufferSize, SMBMaximumBufferSize);
+        
+        if (error == nil && progress) {
+            dispatch_semaphore_wait(pending, DISPATCH_TIME_FOREVER);
+            deliver(nil, 0);
+        }
+        
+        while (error == nil && !finished) {
+            
+            // Room for the chunk is made before it's read, so no more than
+            // SMBMaximumPendingChunks are held at any time
+            if (progress) {
+                dispatch_semaphore_wait(pending, DISPATCH_TIME_FOREVER);
                 
-                if (progress) {
-                    dispatch_async(dispatch_get_main_queue(), ^{
-                        BOOL readMore = progress(bytesReadTotal, nil, NO, error);
+                if (isStopped()) {
+                    dispatch_semaphore_signal(pending);
+                    break;
+                }
+            }
+            
+            NSUInteger bytesToRead = maxBytes == 0 ? size : (NSUInteger)MIN((unsigned long long)size, maxBytes - bytesReadTotal);
+            __block NSData *data = nil;
+            __block long bytesRead = -1;
+            BOOL fromCache = cache != nil;
+            
+            if (fromCache) {
+                // The cache fetches what's missing of the whole range at once. What
+                // lies beyond the size of the status, which may be outdated, is
+                // read from the server by the following iterations.
+                [self _performNow:^(smb_session *session) {
+                    NSError *cacheError = nil;
+                    
+                    if (session) {
+                        data = [self _dataAtOffset:start length:maxBytes cache:cache session:session error:&cacheError];
+                        bytesRead = cacheError ? -1 : (long)data.length;
                         
-                        if (!readMore) {
-                            finished = YES;
+                        if (bytesRead >= 0 && smb_fseek(session, self->_fileID, start + bytesRead, SMB_SEEK_SET) < 0) {
+                            bytesRead = -1;
                         }
-                    });
+                    }
+                } enqueued:[SMBMetricsRecorder now]];
+                
+                cache = nil;
+            } else {
+                void *buf = [pool acquireBuffer:size];
+                
+                if (buf && cachedFile >= 0) {
+                    bytesRead = read(cachedFile, buf, bytesToRead);
+                } else if (buf) {
+                    [self _performNow:^(smb_session *session) {
+                        bytesRead = session ? [self.metricsRecorder read:session file:self->_fileID buffer:buf length:bytesToRead] : -1;
+                    } enqueued:[SMBMetricsRecorder now]];
                 }
                 
-                while (!finished) {
+                if (copyFile >= 0 && bytesRead > 0 && write(copyFile, buf, bytesRead) != bytesRead) {
+                    close(copyFile);
+                    copyFile = -1;
+                }
+                
+                if (bytesRead > 0 && progress) {
+                    data = [pool dataWithBuffer:buf size:size length:bytesRead];
+                } else if (buf) {
+                    [pool releaseBuffer:buf size:size];
+                }
+            }
+            
+            if (bytesRead < 0) {
+                finished = YES;
+                error = [SMBError readError];
+            } else if (bytesRead == 0) {
+                finished = !fromCache;
+            } else {
+                bytesReadTotal += bytesRead;
+                
+                if (bytesReadTotal == maxBytes) {
+                    finished = YES;
+                }
+            }
+            
+            if (progress && data.length > 0) {
+                deliver(data, bytesReadTotal);
+            } else if (progress) {
+                dispatch_semaphore_signal(pending);
+            }
+        }
+        
+        // Let the consumer catch up
+        for (NSUInteger i = 0; i < SMBMaximumPendingChunks; i++) {
+            dispatch_semaphore_wait(pending, DISPATCH_TIME_FOREVER);
+        }
+        for (NSUInteger i = 0; i < SMBMaximumPendingChunks; i++) {
+            dispatch_semaphore_signal(pending);
+        }
+        
+        if (isStopped()) {
+            bytesReadTotal = bytesDelivered;
+        }
+        
+        // Leave the file right after the data that was consumed, as the caches
+        // don't move it
+        if (start >= 0) {
+            unsigned long long position = start + bytesReadTotal;
+            
+            [self _performNow:^(smb_session *session) {
+                if (session) {
+                    smb_fseek(session, self->_fileID, position, SMB_SEEK_SET);
+                }
+            } enqueued:[SMBMetricsRecorder now]];
+        }
+        
+        if (cachedFile >= 0) {
+            close(cachedFile);
+        }
+        
+        if (copyFile >= 0) {
+            close(copyFile);
+        }
+        
+        if (copyPath) {
+            if (copyFile >= 0 && !isStopped() && error == nil && bytesReadTotal == self.size) {
+                [contentCache storeFile:copyPath forFile:self.path status:self->_smbStat move:YES];
+            } else {
+                unlink(copyPath.fileSystemRepresentation);
+            }
+        }
+        
+        if (progress) {
+            [self.share dispatchCompletion:^{
+                progress(bytesReadTotal, nil, YES, error);
+            }];
+        }
+    });
+}
+
+- (void)readIntoBuffers:(nonnull void *_Nullable (^)(NSUInteger *_Nonnull))bufferProvider maxBytes:(unsigned long long)maxBytes progress:(nullable BOOL (^)(unsigned long long, void *_Nullable, NSUInteger, BOOL, NSError *_Nullable))progress {
+    
+    [self _perform:^(smb_session *session) {
+        
+        NSError *error = nil;
+        BOOL finished = NO;
+        __block BOOL stopped = NO;
+        unsigned long long bytesReadTotal = 0;
+        NSObject *lock = [NSObject new];
+        
+        BOOL (^isStopped)(void) = ^BOOL{
+            @synchronized (lock) {
+                return stopped;
+            }
+        };
+        
+        if (session) {
+            if ([self isOpen]) {
+                
+                while (!finished && !isStopped()) {
+                    
+                    NSUInteger bufferSize = 0;
+                    void *buffer = bufferProvider(&bufferSize);
+                    
+                    if (buffer == NULL || bufferSize == 0) {
+                        break;
+                    }
                     
-                    NSUInteger bytesToRead = maxBytes == 0 ? bufferSize : MIN(bufferSize, (NSUInteger)(maxBytes - bytesReadTotal));
-                    long bytesRead = smb_fread(self.share.server.smbSession, self->_fileID, buf, bytesToRead);
+                    NSUInteger bytesToRead = maxBytes == 0 ? bufferSize : (NSUInteger)MIN((unsigned long long)bufferSize, maxBytes - bytesReadTotal);
+                    long bytesRead = [self.metricsRecorder read:session file:self->_fileID buffer:buffer length:bytesToRead];
                     
                     if (bytesRead < 0) {
                         finished = YES;
@@ -242,95 +574,614 @@
                         if (bytesReadTotal == maxBytes) {
                             finished = YES;
                         }
+                    }
+                    
+                    // A buffer nothing was read into is handed back with a length of 0
+                    if (progress) {
+                        unsigned long long total = bytesReadTotal;
+                        NSUInteger length = (NSUInteger)MAX(0L, bytesRead);
                         
-                        if (progress) {
-                            NSData *data = [NSData dataWithBytes:buf length:bytesRead];
+                        [self.share dispatchCompletion:^{
+                            BOOL readMore = progress(total, buffer, length, NO, nil);
                             
-                            dispatch_async(dispatch_get_main_queue(), ^{
-                                BOOL readMore = progress(bytesReadTotal, data, NO, error);
-                                
-                                if (!readMore) {
-                                    finished = YES;
+                            if (!readMore) {
+                                @synchronized (lock) {
+                                    stopped = YES;
                                 }
-                            });
-                        }
+                            }
+                        }];
                     }
                 }
             } else {
-                finished = YES;
                 error = [SMBError notOpenError];
             }
         } else {
-            finished = YES;
             error = [SMBError notConnectedError];
         }
         
         if (progress) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                progress(bytesReadTotal, nil, YES, error);
-            });
+            [self.share dispatchCompletion:^{
+                progress(bytesReadTotal, NULL, 0, YES, error);
+            }];
         }
-    });
+    }];
 }
 
-- (void)write:(nonnull NSData *_Nullable (^)(unsigned long long))dataHandler progress:(nullable void (^)(unsigned long long, long, BOOL, NSError *_Nullable))progress {
-
-    dispatch_async(_serialQueue, ^{
+- (void)read:(NSUInteger)bufferSize maxBytes:(unsigned long long)maxBytes window:(NSUInteger)window progress:(nullable BOOL (^)(unsigned long long, NSData *_Nullable, BOOL, NSError *_Nullable))progress {
+    
+    if (window <= 1 || !self.hasStatus) {
+        [self read:bufferSize maxBytes:maxBytes progress:progress];
+        return;
+    }
     
+    bufferSize = MIN(bufferSize, SMBMaximumBufferSize);
+    
+    [self _perform:^(smb_session *session) {
+        
         NSError *error = nil;
-        unsigned long long offset = 0;
-        BOOL finished = NO;
-
-        if (self.share.server.smbSession) {
+        __block BOOL finished = NO;
+        __block NSError *readError = nil;
+        __block unsigned long long bytesReadTotal = 0;
+        
+        if (session) {
             if ([self isOpen]) {
                 
-                NSData *data;
+                unsigned long long start = MAX(0L, smb_fseek(session, self->_fileID, 0, SMB_SEEK_CUR));
+                unsigned long long length = self.size > start ? self.size - start : 0;
                 
-                if (progress) {
-                    dispatch_async(dispatch_get_main_queue(), ^{
-                        progress(offset, 0, finished, error);
-                    });
+                if (maxBytes > 0) {
+                    length = MIN(length, maxBytes);
                 }
-
-                while (!finished) {
-
-                    data = dataHandler(offset);
-                    
-                    if (data.length == 0) {
-                        finished = YES;
-                    } else {
-                        long bytesToWrite = data.length;
-                        long bytesWritten = smb_fwrite(self.share.server.smbSession, self->_fileID, (void *)data.bytes, bytesToWrite);
+                
+                NSUInteger chunkCount = (NSUInteger)((length + bufferSize - 1) / bufferSize);
+                NSArray<SMBFileLane *> *lanes = [self _lanes:MIN(window, chunkCount) mode:SMB_MOD_RO session:session];
+                
+                SMBBufferPool *pool = self.share.server.bufferPool;
+                
+                // Chunks that have been read, but not yet consumed, are limited to
+                // twice the number of lanes
+                dispatch_semaphore_t windowSemaphore = dispatch_semaphore_create(2 * lanes.count);
+                dispatch_group_t group = dispatch_group_create();
+                NSMutableDictionary<NSNumber *, NSData *> *pending = [NSMutableDictionary dictionary];
+                NSObject *lock = [NSObject new];
+                __block NSUInteger nextChunk = 0;
+                __block NSUInteger nextDelivery = 0;
+                __block NSUInteger endChunk = chunkCount;
+                
+                if (progress) {
+                    [self.share dispatchCompletion:^{
+                        BOOL readMore = progress(0, nil, NO, nil);
                         
-                        offset += MAX(0, bytesWritten);
+                        if (!readMore) {
+                            @synchronized (lock) {
+                                finished = YES;
+                            }
+                        }
+                    }];
+                }
+                
+                for (SMBFileLane *lane in lanes) {
+                    dispatch_group_async(group, lane.queue, ^{
                         
-                        if (bytesWritten != bytesToWrite) {
-                            finished = YES;
-                            error = [SMBError writeError];
-                        } else {
-                            if (progress) {
-                                dispatch_async(dispatch_get_main_queue(), ^{
-                                    progress(offset, MAX(0, bytesWritten), finished, error);
-                                });
+                        while (YES) {
+                            dispatch_semaphore_wait(windowSemaphore, DISPATCH_TIME_FOREVER);
+                            
+                            // The buffer is taken before the chunk, so that the pool waiting for
+                            // memory can't hold back the chunk all others are waiting for
+                            char *buf = [pool acquireBuffer:bufferSize];
+                            NSUInteger chunk = NSNotFound;
+                            
+                            @synchronized (lock) {
+                                if (!finished && nextChunk < endChunk) {
+                                    chunk = nextChunk++;
+                                }
+                            }
+                            
+                            if (chunk == NSNotFound) {
+                                if (buf) {
+                                    [pool releaseBuffer:buf size:bufferSize];
+                                }
+                                dispatch_semaphore_signal(windowSemaphore);
+                                break;
+                            }
+                            
+                            unsigned long long offset = start + (unsigned long long)chunk * bufferSize;
+                            NSUInteger bytesToRead = (NSUInteger)MIN((unsigned long long)bufferSize, start + length - offset);
+                            NSUInteger bytesRead = 0;
+                            long result = buf ? 0 : -1;
+                            
+                            smb_fseek(lane.session, lane.fileID, offset, SMB_SEEK_SET);
+                            
+                            // A single read may return less than requested
+                            while (buf && bytesRead < bytesToRead) {
+                                result = [self.metricsRecorder read:lane.session file:lane.fileID buffer:buf + bytesRead length:bytesToRead - bytesRead];
+                                
+                                if (result <= 0) {
+                                    break;
+                                }
+                                bytesRead += result;
+                            }
+                            
+                            NSData *data = buf ? [pool dataWithBuffer:buf size:bufferSize length:bytesRead] : nil;
+                            
+                            NSUInteger discarded = 0;
+                            
+                            @synchronized (lock) {
+                                if (result < 0) {
+                                    readError = [SMBError readError];
+                                    endChunk = MIN(endChunk, chunk);
+                                } else if (bytesRead < bytesToRead) {
+                                    // The file is shorter than its status told
+                                    endChunk = MIN(endChunk, chunk + 1);
+                                }
+                                
+                                if (chunk < endChunk && data) {
+                                    pending[@(chunk)] = data;
+                                }
+                                
+                                // Chunks beyond the end will never be delivered
+                                for (NSNumber *key in pending.allKeys) {
+                                    if (key.unsignedIntegerValue >= endChunk) {
+                                        [pending removeObjectForKey:key];
+                                        discarded++;
+                                    }
+                                }
+                                if (chunk >= endChunk) {
+                                    discarded++;
+                                }
+                                
+                                // Deliver all chunks that are available in order. Only chunks
+                                // handed over before the consumer declined count as read.
+                                while (pending[@(nextDelivery)] != nil) {
+                                    NSData *chunkData = pending[@(nextDelivery)];
+                                    
+                                    [pending removeObjectForKey:@(nextDelivery)];
+                                    nextDelivery++;
+                                    
+                                    [self.share dispatchCompletion:^{
+                                        BOOL stop = NO;
+                                        unsigned long long total = 0;
+                                        
+                                        @synchronized (lock) {
+                                            stop = finished;
+                                            
+                                            if (!stop) {
+                                                bytesReadTotal += chunkData.length;
+                                                total = bytesReadTotal;
+                                            }
+                                        }
+                                        
+                                        if (!stop && progress && chunkData.length > 0) {
+                                            BOOL readMore = progress(total, chunkData, NO, nil);
+                                            
+                                            if (!readMore) {
+                                                @synchronized (lock) {
+                                                    finished = YES;
+                                                }
+                                            }
+                                        }
+                                        dispatch_semaphore_signal(windowSemaphore);
+                                    }];
+                                }
+                            }
+                            
+                            while (discarded-- > 0) {
+                                dispatch_semaphore_signal(windowSemaphore);
                             }
                         }
-                    }
+                    });
+                }
+                
+                dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+                
+                for (SMBFileLane *lane in lanes) {
+                    [lane close];
                 }
+                
+                // Let the consumer catch up, each chunk gives back its room once
+                // it was handed over or dropped
+                for (NSUInteger i = 0; i < 2 * lanes.count; i++) {
+                    dispatch_semaphore_wait(windowSemaphore, DISPATCH_TIME_FOREVER);
+                }
+                
+                smb_fseek(session, self->_fileID, start + bytesReadTotal, SMB_SEEK_SET);
+                
+                error = readError;
             } else {
-                finished = YES;
                 error = [SMBError notOpenError];
             }
         } else {
-            finished = YES;
             error = [SMBError notConnectedError];
         }
         
         if (progress) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                progress(offset, 0, finished, error);
-            });
-        }
-    });
+            [self.share dispatchCompletion:^{
+                progress(bytesReadTotal, nil, YES, error);
+            }];
+        }
+    }];
+}
+
+- (void)downloadTo:(nonnull NSString *)localPath segments:(NSUInteger)segments progress:(nullable BOOL (^)(unsigned long long, BOOL, NSError *_Nullable))progress {
+    
+    [self _perform:^(smb_session *session) {
+        
+        NSError *error = nil;
+        __block BOOL finished = NO;
+        __block NSError *transferError = nil;
+        __block unsigned long long bytesReadTotal = 0;
+        
+        if (session) {
+            if ([self isOpen]) {
+                
+                unsigned long long size = self.size;
+                SMBContentCache *contentCache = [self _usableContentCache];
+                NSString *cachedPath = [contentCache pathOfFile:self.path status:self->_smbStat];
+                BOOL complete = NO;
+                int localFile = -1;
+                
+                if (cachedPath) {
+                    [[NSFileManager defaultManager] removeItemAtPath:localPath error:nil];
+                    
+                    if ([[NSFileManager defaultManager] copyItemAtPath:cachedPath toPath:localPath error:nil]) {
+                        bytesReadTotal = size;
+                    } else {
+                        error = [SMBError writeError];
+                    }
+                } else if ((localFile = open(localPath.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0 || ftruncate(localFile, size) != 0) {
+                    error = [SMBError writeError];
+                } else {
+                    NSUInteger bufferSize = 1024 * 1024;
+                    ssize_t position = smb_fseek(session, self->_fileID, 0, SMB_SEEK_CUR);
+                    NSArray<SMBFileLane *> *lanes = [self _lanes:(NSUInteger)MIN((unsigned long long)MAX(segments, 1), MAX(size / bufferSize, 1)) mode:SMB_MOD_RO session:session];
+                    unsigned long long segmentSize = (size + lanes.count - 1) / lanes.count;
+                    SMBBufferPool *pool = self.share.server.bufferPool;
+                    dispatch_group_t group = dispatch_group_create();
+                    NSObject *lock = [NSObject new];
+                    
+                    BOOL (^isFinished)(void) = ^BOOL{
+                        @synchronized (lock) {
+                            return finished;
+                        }
+                    };
+                    
+                    if (progress) {
+                        [self.share dispatchCompletion:^{
+                            if (!progress(0, NO, nil)) {
+                                @synchronized (lock) {
+                                    finished = YES;
+                                }
+                            }
+                        }];
+                    }
+                    
+                    [lanes enumerateObjectsUsingBlock:^(SMBFileLane *lane, NSUInteger i, BOOL *stop) {
+                        dispatch_group_async(group, lane.queue, ^{
+                            unsigned long long offset = i * segmentSize;
+                            unsigned long long end = MIN(offset + segmentSize, size);
+                            char *buf = [pool acquireBuffer:bufferSize];
+                            
+                            if (buf && smb_fseek(lane.session, lane.fileID, offset, SMB_SEEK_SET) < 0) {
+                                @synchronized (lock) {
+                                    transferError = [SMBError seekError];
+                                    finished = YES;
+                                }
+                            }
+                            
+                            while (buf && !isFinished() && offset < end) {
+                                NSUInteger bytesToRead = (NSUInteger)MIN((unsigned long long)bufferSize, end - offset);
+                                long bytesRead = [self.metricsRecorder read:lane.session file:lane.fileID buffer:buf length:bytesToRead];
+                                NSError *laneError = nil;
+                                
+                                // Ending before the segment does means the file is shorter than its
+                                // status told, and the local file would have a hole
+                                if (bytesRead <= 0) {
+                                    laneError = [SMBError readError];
+                                } else if (pwrite(localFile, buf, bytesRead, offset) != bytesRead) {
+                                    laneError = [SMBError writeError];
+                                }
+                                
+                                @synchronized (lock) {
+                                    if (laneError) {
+                                        transferError = laneError;
+                                        finished = YES;
+                                    } else {
+                                        bytesReadTotal += bytesRead;
+                                        offset += bytesRead;
+                                        
+                                        unsigned long long total = bytesReadTotal;
+                                        
+                                        if (progress) {
+                                            [self.share dispatchCompletion:^{
+                                                if (!isFinished() && !progress(total, NO, nil)) {
+                                                    @synchronized (lock) {
+                                                        finished = YES;
+                                                    }
+                                                }
+                                            }];
+                                        }
+                                    }
+                                }
+                            }
+                            
+                            if (buf) {
+                                [pool releaseBuffer:buf size:bufferSize];
+                            } else {
+                                @synchronized (lock) {
+                                    transferError = [SMBError unknownError];
+                                    finished = YES;
+                                }
+                            }
+                        });
+                    }];
+                    
+                    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+                    
+                    for (SMBFileLane *lane in lanes) {
+                        [lane close];
+                    }
+                    
+                    // The first lane reads with the file's own handle, whose position stays
+                    if (position >= 0) {
+                        smb_fseek(session, self->_fileID, position, SMB_SEEK_SET);
+                    }
+                    
+                    error = transferError;
+                    complete = error == nil && !isFinished() && bytesReadTotal == size;
+                }
+                
+                if (localFile >= 0) {
+                    close(localFile);
+                    
+                    if (complete) {
+                        [contentCache storeFile:localPath forFile:self.path status:self->_smbStat move:NO];
+                    }
+                }
+            } else {
+                error = [SMBError notOpenError];
+            }
+        } else {
+            error = [SMBError notConnectedError];
+        }
+        
+        if (progress) {
+            [self.share dispatchCompletion:^{
+                progress(bytesReadTotal, YES, error);
+            }];
+        }
+    }];
+}
+
+- (void)write:(nonnull NSData *_Nullable (^)(unsigned long long))dataHandler progress:(nullable void (^)(unsigned long long, long, BOOL, NSError *_Nullable))progress {
+
+    [self _perform:^(smb_session *session) {
+    
+        NSError *error = nil;
+        unsigned long long offset = 0;
+        BOOL finished = NO;
+
+        if (session) {
+            if ([self isOpen]) {
+                
+                NSData *data;
+                
+                if (progress) {
+                    [self.share dispatchCompletion:^{
+                        progress(offset, 0, finished, error);
+                    }];
+                }
+
+                while (!finished) {
+
+                    data = dataHandler(offset);
+                    
+                    if (data.length == 0) {
+                        finished = YES;
+                    } else {
+                        long bytesToWrite = data.length;
+                        long bytesWritten = [self.metricsRecorder write:session file:self->_fileID buffer:data.bytes length:bytesToWrite];
+                        
+                        offset += MAX(0, bytesWritten);
+                        
+                        if (bytesWritten != bytesToWrite) {
+                            finished = YES;
+                            error = [SMBError writeError];
+                        } else {
+                            if (progress) {
+                                [self.share dispatchCompletion:^{
+                                    progress(offset, MAX(0, bytesWritten), finished, error);
+                                }];
+                            }
+                        }
+                    }
+                }
+            } else {
+                finished = YES;
+                error = [SMBError notOpenError];
+            }
+        } else {
+            finished = YES;
+            error = [SMBError notConnectedError];
+        }
+        
+        if (progress) {
+            [self.share dispatchCompletion:^{
+                progress(offset, 0, finished, error);
+            }];
+        }
+    }];
+}
+
+- (void)write:(nonnull NSData *_Nullable (^)(unsigned long long))dataHandler bufferSize:(NSUInteger)bufferSize window:(NSUInteger)window progress:(nullable void (^)(unsigned long long, long, BOOL, NSError *_Nullable))progress {
+    
+    bufferSize = MIN(MAX(bufferSize, 1), SMBMaximumBufferSize);
+    
+    [self _perform:^(smb_session *session) {
+        
+        NSError *error = nil;
+        __block BOOL finished = NO;
+        __block NSError *writeError = nil;
+        __block unsigned long long bytesWrittenTotal = 0;
+        
+        if (session) {
+            if ([self isOpen]) {
+                
+                unsigned long long start = MAX(0L, smb_fseek(session, self->_fileID, 0, SMB_SEEK_CUR));
+                NSArray<SMBFileLane *> *lanes = [self _lanes:MAX(window, 1) mode:SMB_MOD_RW session:session];
+                SMBBufferPool *pool = self.share.server.bufferPool;
+                dispatch_semaphore_t windowSemaphore = dispatch_semaphore_create(0);
+                dispatch_group_t group = dispatch_group_create();
+                NSObject *lock = [NSObject new];
+                // Lengths of the chunks acknowledged beyond the written prefix of the
+                // data, by offset. Only the prefix counts as written, as a failed chunk
+                // leaves a hole before those after it.
+                NSMutableDictionary<NSNumber *, NSNumber *> *acknowledged = [NSMutableDictionary dictionary];
+                unsigned long long offset = 0;
+                NSUInteger chunk = 0;
+                NSData *data = nil;
+                NSUInteger dataOffset = 0;
+                BOOL exhausted = NO;
+                
+                BOOL (^isFinished)(void) = ^BOOL{
+                    @synchronized (lock) {
+                        return finished;
+                    }
+                };
+                
+                // Buffers that have been filled, but not yet written, are limited
+                // to the size of the window
+                for (NSUInteger i = 0; i < MAX(window, 1); i++) {
+                    dispatch_semaphore_signal(windowSemaphore);
+                }
+                
+                if (progress) {
+                    [self.share dispatchCompletion:^{
+                        progress(0, 0, NO, nil);
+                    }];
+                }
+                
+                while (!exhausted && !isFinished()) {
+                    dispatch_semaphore_wait(windowSemaphore, DISPATCH_TIME_FOREVER);
+                    
+                    char *buf = [pool acquireBuffer:bufferSize];
+                    NSUInteger length = 0;
+                    
+                    // Coalesce the data of the handler into a buffer of bufferSize bytes
+                    while (buf && length < bufferSize) {
+                        if (dataOffset == data.length) {
+                            data = dataHandler(offset + length);
+                            dataOffset = 0;
+                            
+                            if (data.length == 0) {
+                                exhausted = YES;
+                                break;
+                            }
+                        }
+                        
+                        NSUInteger bytes = MIN(bufferSize - length, data.length - dataOffset);
+                        
+                        [data getBytes:buf + length range:NSMakeRange(dataOffset, bytes)];
+                        dataOffset += bytes;
+                        length += bytes;
+                    }
+                    
+                    if (buf == NULL || length == 0 || isFinished()) {
+                        if (buf) {
+                            [pool releaseBuffer:buf size:bufferSize];
+                        } else {
+                            @synchronized (lock) {
+                                writeError = writeError ?: [SMBError unknownError];
+                                finished = YES;
+                            }
+                        }
+                        dispatch_semaphore_signal(windowSemaphore);
+                        break;
+                    }
+                    
+                    SMBFileLane *lane = lanes[chunk++ % lanes.count];
+                    unsigned long long chunkStart = offset;
+                    unsigned long long chunkOffset = start + offset;
+                    
+                    offset += length;
+                    
+                    dispatch_group_async(group, lane.queue, ^{
+                        long bytesWritten = 0;
+                        
+                        @synchronized (lock) {
+                            bytesWritten = writeError ? -1 : 0;
+                        }
+                        
+                        if (bytesWritten == 0) {
+                            smb_fseek(lane.session, lane.fileID, chunkOffset, SMB_SEEK_SET);
+                            
+                            // A single write may accept less than requested
+                            while (bytesWritten < (long)length) {
+                                long result = [self.metricsRecorder write:lane.session file:lane.fileID buffer:buf + bytesWritten length:length - bytesWritten];
+                                
+                                if (result <= 0) {
+                                    break;
+                                }
+                                bytesWritten += result;
+                            }
+                        }
+                        
+                        [pool releaseBuffer:buf size:bufferSize];
+                        
+                        @synchronized (lock) {
+                            if (bytesWritten != (long)length) {
+                                if (writeError == nil) {
+                                    writeError = [SMBError writeError];
+                                }
+                                finished = YES;
+                            } else {
+                                unsigned long long previousTotal = bytesWrittenTotal;
+                                
+                                acknowledged[@(chunkStart)] = @(bytesWritten);
+                                
+                                while (acknowledged[@(bytesWrittenTotal)] != nil) {
+                                    NSNumber *key = @(bytesWrittenTotal);
+                                    
+                                    bytesWrittenTotal += acknowledged[key].unsignedLongLongValue;
+                                    [acknowledged removeObjectForKey:key];
+                                }
+                                
+                                unsigned long long total = bytesWrittenTotal;
+                                long bytesWrittenLast = (long)(total - previousTotal);
+                                
+                                if (progress && bytesWrittenLast > 0) {
+                                    [self.share dispatchCompletion:^{
+                                        progress(total, bytesWrittenLast, NO, nil);
+                                    }];
+                                }
+                            }
+                        }
+                        
+                        dispatch_semaphore_signal(windowSemaphore);
+                    });
+                }
+                
+                dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+                
+                for (SMBFileLane *lane in lanes) {
+                    [lane close];
+                }
+                
+                smb_fseek(session, self->_fileID, start + bytesWrittenTotal, SMB_SEEK_SET);
+                
+                error = writeError;
+            } else {
+                error = [SMBError notOpenError];
+            }
+        } else {
+            error = [SMBError notConnectedError];
+        }
+        
+        if (progress) {
+            [self.share dispatchCompletion:^{
+                progress(bytesWrittenTotal, 0, YES, error);
+            }];
+        }
+    }];
 }
 
 - (void)listFiles:(nullable void (^)(NSArray<SMBFile *> *_Nullable, NSError *_Nullable))completion {
@@ -342,14 +1193,12 @@
         [self updateStatus:^(NSError *error) {
             if (error) {
                 if (completion) {
-                    dispatch_async(dispatch_get_main_queue(), ^{
-                        completion(nil, error);
-                    });
+                    completion(nil, error);
                 }
             } else if (!self.hasStatus || !self.isDirectory) {
-                dispatch_async(dispatch_get_main_queue(), ^{
+                if (completion) {
                     completion(nil, [SMBError notSuchFileOrDirectory]);
-                });
+                }
             } else {
                 [self.share listFiles:self.path filter:filter completion:completion];
             }
@@ -359,15 +1208,45 @@
     //}
 }
 
+- (void)listFiles:(NSUInteger)batchSize filter:(nullable BOOL (^)(SMBFile *_Nonnull))filter progress:(nullable BOOL (^)(NSArray<SMBFile *> *_Nullable, BOOL, NSError *_Nullable))progress {
+    [self updateStatus:^(NSError *error) {
+        if (error == nil && (!self.hasStatus || !self.isDirectory)) {
+            error = [SMBError notSuchFileOrDirectory];
+        }
+        
+        if (error) {
+            if (progress) {
+                progress(nil, YES, error);
+            }
+        } else {
+            [self.share listFiles:self.path batchSize:batchSize filter:filter progress:progress];
+        }
+    }];
+}
+
+- (void)listFilesRecursively:(NSUInteger)concurrency filter:(nullable BOOL (^)(SMBFile *_Nonnull))filter progress:(nullable BOOL (^)(NSArray<SMBFile *> *_Nullable, BOOL, NSError *_Nullable))progress {
+    [self updateStatus:^(NSError *error) {
+        if (error == nil && (!self.hasStatus || !self.isDirectory)) {
+            error = [SMBError notSuchFileOrDirectory];
+        }
+        
+        if (error) {
+            if (progress) {
+                progress(nil, YES, error);
+            }
+        } else {
+            [self.share listFilesRecursively:self.path concurrency:concurrency filter:filter progress:progress];
+        }
+    }];
+}
+
 - (void)updateStatus:(nullable void (^)(NSError *_Nullable))completion {
     [self.share getStatusOfFile:self.path completion:^(SMBStat * _Nullable smbStat, NSError * _Nullable error) {
         if (error == nil) {
             self->_smbStat = smbStat;
         }
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(error);
-            });
+            completion(error);
         }
     }];
 }
@@ -378,9 +1257,7 @@
             self->_smbStat = file.smbStat;
         }
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(error);
-            });
+            completion(error);
         }
     }];
 }
@@ -391,9 +1268,7 @@
             self->_smbStat = file.smbStat;
         }
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(error);
-            });
+            completion(error);
         }
     }];
 }
@@ -404,13 +1279,44 @@
             self->_smbStat = [SMBStat statForNonExistingFile];
         }
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(error);
-            });
+            completion(error);
+        }
+    }];
+}
+
+- (void)deleteRecursively:(NSUInteger)concurrency progress:(nullable BOOL (^)(NSUInteger, unsigned long long, BOOL, NSError *_Nullable))progress {
+    [self.share deleteRecursively:self.path concurrency:concurrency progress:^BOOL(NSUInteger filesDeleted, unsigned long long bytesDeleted, BOOL complete, NSError *error) {
+        if (complete && error == nil) {
+            self->_smbStat = [SMBStat statForNonExistingFile];
         }
+        return progress ? progress(filesDeleted, bytesDeleted, complete, error) : YES;
     }];
 }
 
+- (void)downloadDirectoryTo:(nonnull NSString *)localPath concurrency:(NSUInteger)concurrency progress:(nullable BOOL (^)(NSUInteger, unsigned long long, BOOL, NSError *_Nullable))progress {
+    [self.share downloadDirectory:self.path to:localPath concurrency:concurrency progress:progress];
+}
+
+- (void)uploadDirectoryFrom:(nonnull NSString *)localPath concurrency:(NSUInteger)concurrency progress:(nullable BOOL (^)(NSUInteger, unsigned long long, BOOL, NSError *_Nullable))progress {
+    [self.share uploadDirectory:localPath to:self.path concurrency:concurrency progress:progress];
+}
+
+- (void)resumableDownloadTo:(nonnull NSString *)localPath progress:(nullable BOOL (^)(unsigned long long, BOOL, NSError *_Nullable))progress {
+    [self.share resumableDownload:self.path to:localPath progress:progress];
+}
+
+- (void)resumableUploadFrom:(nonnull NSString *)localPath progress:(nullable BOOL (^)(unsigned long long, BOOL, NSError *_Nullable))progress {
+    [self.share resumableUpload:localPath to:self.path progress:progress];
+}
+
+- (SMBMetrics *)metrics {
+    return [self.metricsRecorder snapshot];
+}
+
+- (void)resetMetrics {
+    [self.metricsRecorder reset];
+}
+
 - (void)moveTo:(nonnull NSString *)path completion:(nullable void (^)(NSError *_Nullable))completion {
     SMBFile *f = [SMBFile fileWithPath:path relativeToFile:self];
     
@@ -420,15 +1326,276 @@
             self->_path = newFile.path;
         }
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(error);
-            });
+            completion(error);
         }
     }];
 }
 
+#pragma mark - Private methods
+
+// Listings create lots of files that are never opened, so the queue is only
+// created when it's needed
+- (dispatch_queue_t)serialQueue {
+    @synchronized (self) {
+        if (_serialQueue == nil) {
+            NSString *queueName = [NSString stringWithFormat:@"smb_file_queue_%@", _path];
+            
+            _serialQueue = dispatch_queue_create(queueName.UTF8String, DISPATCH_QUEUE_SERIAL);
+        }
+        return _serialQueue;
+    }
+}
+
+// The cache is only used for files opened for reading only, whose size is known.
+// Changes others make to the file while it's open aren't noticed.
+- (SMBBlockCache *)_usableBlockCache {
+    SMBBlockCache *cache = self.blockCache;
+    
+    return cache && (_mode & SMBFileModeWrite) == 0 && self.hasStatus ? cache : nil;
+}
+
+// Copies are only made of files opened for reading, whose status is current
+- (SMBContentCache *)_usableContentCache {
+    SMBContentCache *cache = self.share.contentCache;
+    
+    return cache.sizeLimit > 0 && (_mode & SMBFileModeWrite) == 0 && self.hasStatus && !self.isDirectory ? cache : nil;
+}
+
+// Returns up to length bytes at offset from the block cache. The cache only covers
+// the file up to the size of its status, callers read anything beyond from the
+// server. Missing blocks are fetched together with those the access pattern
+// suggests to read ahead, contiguous ones in a single request. The position of the
+// file is left undefined.
+- (NSData *)_dataAtOffset:(unsigned long long)offset length:(unsigned long long)length cache:(SMBBlockCache *)cache session:(smb_session *)session error:(NSError **)error {
+    const unsigned long long blockSize = SMBBlockCacheBlockSize;
+    NSError *err = nil;
+    NSMutableData *data = [NSMutableData data];
+    unsigned long long size = self.size;
+    
+    if (offset < size && length > 0) {
+        unsigned long long end = MIN(offset + length, size);
+        unsigned long long first = offset / blockSize;
+        unsigned long long last = (end - 1) / blockSize;
+        unsigned long long lastFetched = MIN(last + [cache readAheadForBlocksFrom:first to:last], (size - 1) / blockSize);
+        NSMutableDictionary<NSNumber *, NSData *> *blocks = [NSMutableDictionary dictionary];
+        unsigned long long index = first;
+        
+        while (index <= lastFetched && err == nil) {
+            NSData *block = [cache blockAtIndex:index];
+            
+            if (block) {
+                if (index <= last) {
+                    blocks[@(index)] = block;
+                }
+                index++;
+                continue;
+            }
+            
+            unsigned long long count = 1;
+            
+            while (index + count <= lastFetched && count < SMBMaximumBufferSize / blockSize && [cache blockAtIndex:index + count] == nil) {
+                count++;
+            }
+            
+            unsigned long long fetchOffset = index * blockSize;
+            NSUInteger fetchLength = (NSUInteger)MIN(count * blockSize, size - fetchOffset);
+            NSMutableData *buffer = [NSMutableData dataWithLength:fetchLength];
+            NSUInteger bytesRead = 0;
+            
+            if (smb_fseek(session, _fileID, fetchOffset, SMB_SEEK_SET) < 0) {
+                err = [SMBError seekError];
+            }
+            
+            while (err == nil && bytesRead < fetchLength) {
+                ssize_t result = [self.metricsRecorder read:session file:_fileID buffer:(char *)buffer.mutableBytes + bytesRead length:fetchLength - bytesRead];
+                
+                if (result < 0) {
+                    err = [SMBError readError];
+                } else if (result == 0) {
+                    break;
+                } else {
+                    bytesRead += result;
+                }
+            }
+            
+            for (unsigned long long i = 0; err == nil && i < count && i * blockSize < bytesRead; i++) {
+                NSData *block = [buffer subdataWithRange:NSMakeRange((NSUInteger)(i * blockSize), (NSUInteger)MIN(blockSize, bytesRead - i * blockSize))];
+                
+                [cache setBlock:block atIndex:index + i];
+                
+                if (index + i <= last) {
+                    blocks[@(index + i)] = block;
+                }
+            }
+            
+            // The file is shorter than its status says
+            if (bytesRead < fetchLength) {
+                break;
+            }
+            
+            index += count;
+        }
+        
+        if (err == nil) {
+            data = [NSMutableData dataWithCapacity:(NSUInteger)(end - offset)];
+            
+            for (index = first; index <= last; index++) {
+                NSData *block = blocks[@(index)];
+                unsigned long long blockStart = index * blockSize;
+                unsigned long long from = MAX(offset, blockStart) - blockStart;
+                unsigned long long to = MIN(end - blockStart, (unsigned long long)block.length);
+                
+                if (from >= to) {
+                    break;
+                }
+                
+                [data appendBytes:(const char *)block.bytes + from length:(NSUInteger)(to - from)];
+            }
+        }
+    }
+    
+    if (error) {
+        *error = err;
+    }
+    
+    return err ? nil : data;
+}
+
+// Reads up to length bytes at offset, less only at the end of the file. The
+// position of the file is left undefined.
+- (NSData *)_dataAtOffset:(unsigned long long)offset length:(NSUInteger)length session:(smb_session *)session error:(NSError **)error {
+    NSError *err = nil;
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    NSUInteger bytesRead = 0;
+    
+    if (smb_fseek(session, _fileID, offset, SMB_SEEK_SET) < 0) {
+        err = [SMBError seekError];
+    }
+    
+    while (err == nil && bytesRead < length) {
+        ssize_t result = [self.metricsRecorder read:session file:_fileID buffer:(char *)data.mutableBytes + bytesRead length:length - bytesRead];
+        
+        if (result < 0) {
+            err = [SMBError readError];
+        } else if (result == 0) {
+            break;
+        } else {
+            bytesRead += result;
+        }
+    }
+    
+    data.length = bytesRead;
+    
+    if (error) {
+        *error = err;
+    }
+    
+    return err ? nil : data;
+}
+
+// Like the queue, the recorder is only created when the file is used
+- (SMBMetricsRecorder *)metricsRecorder {
+    @synchronized (self) {
+        if (_metricsRecorder == nil) {
+            _metricsRecorder = [[SMBMetricsRecorder alloc] initWithParent:self.share.metricsRecorder];
+        }
+        return _metricsRecorder;
+    }
+}
+
+// The first lane uses the given session and the handle of the file, the others
+// are opened as far as the server allows
+- (NSArray<SMBFileLane *> *)_lanes:(NSUInteger)count mode:(uint32_t)mod session:(smb_session *)session {
+    NSMutableArray<SMBFileLane *> *lanes = [NSMutableArray arrayWithObject:[[SMBFileLane alloc] initWithSession:session fileID:_fileID owned:NO]];
+    
+    while (lanes.count < count) {
+        SMBFileLane *lane = [SMBFileLane laneForFile:self mode:mod];
+        
+        if (lane == nil) {
+            break;
+        }
+        [lanes addObject:lane];
+    }
+    
+    return lanes;
+}
+
+// Runs the block on the file's queue, while holding the session the file was
+// opened on
+- (void)_perform:(void (^)(smb_session *session))block {
+    uint64_t enqueued = [SMBMetricsRecorder now];
+    
+    dispatch_async(self.serialQueue, ^{
+        [self _performNow:block enqueued:enqueued];
+    });
+}
+
+// Runs the block right away, holding the session only while it runs. Must be
+// called on the file's queue.
+- (void)_performNow:(void (^)(smb_session *session))block enqueued:(uint64_t)enqueued {
+    SMBSession *session = _session;
+    
+    if (session && [self isOpen]) {
+        [session performAndWait:^(SMBSession *s) {
+            [self.metricsRecorder waitedSince:enqueued];
+            
+            if (s.generation != self->_generation && ![self _reopenOn:s]) {
+                // The handle is gone with the old session, so is the file's
+                // position. The block only reports the error.
+                block(NULL);
+                return;
+            }
+            
+            block(s.smbSession);
+            
+            // Only updates the client side offset, no request is sent
+            ssize_t position = s.smbSession ? smb_fseek(s.smbSession, self->_fileID, 0, SMB_SEEK_CUR) : -1;
+            
+            if (position >= 0) {
+                self->_position = position;
+            }
+        }];
+    } else {
+        [self.metricsRecorder waitedSince:enqueued];
+        block(self.share.server.smbSession);
+    }
+}
+
+// The session was lost and replaced since the file was opened. If the file can't
+// be opened again, it is left closed.
+- (BOOL)_reopenOn:(SMBSession *)session {
+    smb_fd fileID = [self.share reopenFile:self.path mode:_mode session:session metricsRecorder:self.metricsRecorder error:nil];
+    
+    // The file may have changed meanwhile
+    [self.blockCache removeAllBlocks];
+    
+    if (fileID == 0) {
+        _fileID = 0;
+        _session = nil;
+        return NO;
+    }
+    
+    _fileID = fileID;
+    _generation = session.generation;
+    smb_fseek(session.smbSession, fileID, _position, SMB_SEEK_SET);
+    
+    return YES;
+}
+
 #pragma mark - Overwritten getters and setters
 
+- (void)setBlockCacheSize:(NSUInteger)blockCacheSize {
+    @synchronized (self) {
+        _blockCacheSize = blockCacheSize;
+        
+        if (blockCacheSize > 0) {
+            self.blockCache = [[SMBBlockCache alloc] initWithCapacity:(blockCacheSize + SMBBlockCacheBlockSize - 1) / SMBBlockCacheBlockSize];
+        } else {
+            self.blockCache = nil;
+        }
+    }
+}
+
 - (NSString *)name {
     return _path.pathComponents.lastObject;
 }
@@ -470,3 +1637,99 @@
 }
 
 @end
+
+@implementation SMBFileLane {
+    BOOL _owned;
+    SMBFileServer *_server;
+    SMBMetricsRecorder *_metricsRecorder;
+    NSMutableDictionary<NSString *, NSNumber *> *_shareIDs;
+}
+
++ (instancetype)laneForFile:(SMBFile *)file mode:(uint32_t)mod {
+    SMBFileServer *server = file.share.server;
+    NSMutableDictionary<NSString *, NSNumber *> *shareIDs = [NSMutableDictionary dictionary];
+    smb_session *session = [server keptSession:shareIDs];
+    SMBFileLane *lane = nil;
+    
+    // The session of an earlier transfer saves logging in again, unless the server
+    // dropped it meanwhile
+    if (session) {
+        lane = [self _laneForFile:file mode:mod session:session shareIDs:shareIDs];
+        
+        if (lane == nil) {
+            [shareIDs removeAllObjects];
+        }
+    }
+    
+    if (lane == nil && (session = [server createSession:nil shareIDs:shareIDs])) {
+        lane = [self _laneForFile:file mode:mod session:session shareIDs:shareIDs];
+    }
+    
+    return lane;
+}
+
+// Opens the file on the session, or destroys the session if that fails
++ (instancetype)_laneForFile:(SMBFile *)file mode:(uint32_t)mod session:(smb_session *)session shareIDs:(NSMutableDictionary<NSString *, NSNumber *> *)shareIDs {
+    SMBFileLane *lane = nil;
+    SMBMetricsRecorder *recorder = file.metricsRecorder;
+    NSString *smbPath = [file.path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+    NSString *name = file.share.name;
+    smb_tid shareID = shareIDs[name].unsignedShortValue;
+    smb_fd fileID = 0;
+    
+    if (shareIDs[name] == nil) {
+        uint64_t start = [recorder begin:SMBOperationTreeConnect];
+        int dsm_error = smb_tree_connect(session, name.UTF8String, &shareID);
+        
+        [recorder end:SMBOperationTreeConnect start:start result:dsm_error];
+        
+        if (dsm_error == 0) {
+            shareIDs[name] = @(shareID);
+        }
+    }
+    
+    if (shareIDs[name]) {
+        uint64_t start = [recorder begin:SMBOperationOpen];
+        int dsm_error = smb_fopen(session, shareID, smbPath.UTF8String, mod, &fileID);
+        
+        [recorder end:SMBOperationOpen start:start result:dsm_error];
+        
+        if (dsm_error == 0) {
+            lane = [[self alloc] initWithSession:session fileID:fileID owned:YES];
+            lane->_server = file.share.server;
+            lane->_metricsRecorder = recorder;
+            lane->_shareIDs = shareIDs;
+        }
+    }
+    
+    if (lane == nil) {
+        smb_session_destroy(session);
+    }
+    
+    return lane;
+}
+
+- (instancetype)initWithSession:(smb_session *)session fileID:(smb_fd)fileID owned:(BOOL)owned {
+    self = [super init];
+    if (self) {
+        _session = session;
+        _fileID = fileID;
+        _owned = owned;
+        _queue = dispatch_queue_create("smb_file_lane_queue", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+// Leaves the session and its tree to the next lane
+- (void)close {
+    if (_owned && _session) {
+        uint64_t start = [_metricsRecorder begin:SMBOperationClose];
+        
+        smb_fclose(_session, _fileID);
+        [_metricsRecorder end:SMBOperationClose start:start result:0];
+        [_server keepSession:_session shareIDs:_shareIDs];
+    }
+    _session = NULL;
+}
+
+@end
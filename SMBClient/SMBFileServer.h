@@ -25,15 +25,59 @@
 #import "SMBDevice.h"
 #import "SMBShare.h"
 
+@class SMBMetrics;
+
 @interface SMBFileServer : SMBDevice
 
+// The number of sessions share and file operations are spread over. Additional
+// sessions are opened when all sessions are busy. Defaults to 1.
+@property (nonatomic) NSUInteger maxSessions;
+// Memory kept in buffers for file transfers on this server. Beyond it, buffers
+// are allocated for each read and freed again. Defaults to 32 MB.
+@property (nonatomic) NSUInteger bufferMemoryLimit;
+// The queue completion and progress blocks are called on, unless a share has a
+// queue of its own. Defaults to nil, which is the main queue.
+@property (nonatomic, nullable) dispatch_queue_t completionQueue;
+// When set, blocks are called right on the queue that did the work, which saves
+// a hop but stalls further operations until the block returns. Defaults to NO.
+@property (nonatomic) BOOL directCompletions;
+// Idle sessions check that the server still answers this often. Defaults to 0,
+// which sends no keep alives.
+@property (nonatomic) NSTimeInterval keepAliveInterval;
+// When set, sessions found dead by a keep alive or a failed request connect again
+// with the credentials of the last successful connect, also without keep alives.
+// Open shares and files stay usable, files are reopened at their last position,
+// or left closed if that fails. Defaults to NO.
+@property (nonatomic) BOOL reconnectsAutomatically;
+// The list of shares is reused for this many seconds. Defaults to 0, which asks
+// the server every time.
+@property (nonatomic) NSTimeInterval shareListLifetime;
+// Shares stay connected this long after they were closed, so opening them again
+// is free. Defaults to 0, which disconnects them right away.
+@property (nonatomic) NSTimeInterval idleShareTimeout;
+// Latencies, queue waits and bytes transferred of everything done on this server,
+// including its shares and files
+@property (nonatomic, readonly, nonnull) SMBMetrics *metrics;
+// Emits an os_signpost interval for each request to the server, on iOS 12 and
+// later. Defaults to NO.
+@property (nonatomic) BOOL signpostsEnabled;
+
+// Sessions of disconnected servers are kept this long, and used by the next server
+// that connects to the same host with the same credentials. This saves connecting
+// and logging in again, e.g. for servers recreated by discovery. Sessions with
+// files still open are closed. Defaults to 0, which closes sessions right away.
++ (NSTimeInterval)idleSessionTimeout;
++ (void)setIdleSessionTimeout:(NSTimeInterval)idleSessionTimeout;
+
 - (nullable instancetype)initWithHost:(nonnull NSString *)ipAddressOrHostname netbiosName:(nonnull NSString *)name group:(nullable NSString *)group;
 
 - (void)disconnect:(nullable void (^)(void))completion;
 - (void)connectAsUser:(nullable NSString *)username password:(nullable NSString *)password completion:(nullable void (^)(BOOL guest, NSError *_Nullable error))completion;
 - (void)connectAsUser:(nullable NSString *)username password:(nullable NSString *)password domain:(nullable NSString *)domain completion:(nullable void (^)(BOOL guest, NSError *_Nullable error))completion;
 - (void)listShares:(nullable void (^)(NSArray<SMBShare *> *_Nullable shares, NSError *_Nullable error))completion;
+// Returns the share opened or found before, as long as it's still in use
 - (void)findShare:(nonnull NSString *)name completion:(nullable void (^)(SMBShare *_Nullable share, NSError *_Nullable error))completion;
+- (void)resetMetrics;
 
 #pragma mark - Unavailable methods
 
@@ -25,19 +25,49 @@
 #import "SMBFileServer_Protected.h"
 #import "SMBError.h"
 #import "SMBShare_Protected.h"
-
-#import <netdb.h>
+#import "SMBBufferPool.h"
+#import "SMBSession.h"
+#import "SMBMetricsRecorder.h"
+#import "SMBResolver.h"
+#import "SMBSessionRegistry.h"
 
 #import "smb_session.h"
 #import "smb_share.h"
 
+// The time to wait for one of the addresses of the host to accept a connection
+static const NSTimeInterval SMBFileServerConnectTimeout = 5;
+
+// The time and number of sessions of transfers kept for the next transfer
+static const NSTimeInterval SMBFileServerKeptSessionTimeout = 60;
+static const NSUInteger SMBFileServerMaxKeptSessions = 8;
+
+// Identifies the queue of a server, to tell whether it is the current one
+static void *SMBFileServerQueueKey = &SMBFileServerQueueKey;
+
 @interface SMBFileServer ()
 
 @property (nonatomic) dispatch_queue_t serialQueue;
+@property (nonatomic, copy) NSString *username;
+@property (nonatomic, copy) NSString *password;
+@property (nonatomic, copy) NSString *domain;
+@property (nonatomic) NSMutableArray<SMBSession *> *sessions;
 
 @end
 
-@implementation SMBFileServer
+@implementation SMBFileServer {
+    dispatch_source_t _keepAliveTimer;
+    NSTimeInterval _reconnectDelay;
+    CFAbsoluteTime _reconnectTime;
+    // Shares handed out, by lowercased name, as long as they are in use
+    NSMapTable<NSString *, SMBShare *> *_shares;
+    // Sessions of earlier transfers with a window or segments, ready for the next
+    SMBSessionRegistry *_keptSessions;
+    // The following are only used on the queue of the server
+    NSArray<NSString *> *_shareList;
+    CFAbsoluteTime _shareListTime;
+    NSMutableDictionary<NSString *, NSNumber *> *_shareOpenCounts;
+    NSMutableDictionary<NSString *, NSObject *> *_idleShares;
+}
 
 - (instancetype)initWithHost:(NSString *)ipAddressOrHostname netbiosName:(NSString *)name group:(NSString *)group {
     self = [super initWithType:SMBDeviceTypeFileServer host:ipAddressOrHostname netbiosName:name group:group];
@@ -45,17 +75,116 @@
         NSString *queueName = [NSString stringWithFormat:@"smb_server_queue_%@", ipAddressOrHostname];
 
         _serialQueue = dispatch_queue_create(queueName.UTF8String, DISPATCH_QUEUE_SERIAL);
+        dispatch_queue_set_specific(_serialQueue, SMBFileServerQueueKey, (__bridge void *)self, NULL);
+        _bufferPool = [[SMBBufferPool alloc] initWithMemoryLimit:32 * 1024 * 1024];
+        _metricsRecorder = [[SMBMetricsRecorder alloc] initWithParent:nil];
+        _sessions = [NSMutableArray array];
+        _maxSessions = 1;
+        _shares = [NSMapTable strongToWeakObjectsMapTable];
+        _shareOpenCounts = [NSMutableDictionary dictionary];
+        _idleShares = [NSMutableDictionary dictionary];
+        _keptSessions = [SMBSessionRegistry new];
+        _keptSessions.idleTimeout = SMBFileServerKeptSessionTimeout;
+        _keptSessions.maxIdleSessions = SMBFileServerMaxKeptSessions;
     }
     return self;
 }
 
 - (void)dealloc {
+    if (_keepAliveTimer) {
+        dispatch_source_cancel(_keepAliveTimer);
+    }
+    [self _recycleKeptSessions];
     if (_smbSession) {
-        smb_session_destroy(_smbSession);
+        // The session is only used on the queue of the server, which the server may
+        // be released on
+        SMBSession *session = _sessions.firstObject;
+        __block NSDictionary<NSString *, NSNumber *> *shareIDs = nil;
+        __block NSUInteger openFiles = 0;
+        void (^read)(void) = ^{
+            shareIDs = session.shareIDs;
+            openFiles = session.openFiles;
+        };
+        
+        if (dispatch_get_specific(SMBFileServerQueueKey) == (__bridge void *)self) {
+            read();
+        } else {
+            dispatch_sync(_serialQueue, read);
+        }
+        
+        if (openFiles == 0) {
+            [self recycleSession:_smbSession shareIDs:shareIDs];
+        } else {
+            smb_session_destroy(_smbSession);
+        }
         _smbSession = nil;
     }
 }
 
++ (NSTimeInterval)idleSessionTimeout {
+    return [SMBSessionRegistry sharedRegistry].idleTimeout;
+}
+
++ (void)setIdleSessionTimeout:(NSTimeInterval)idleSessionTimeout {
+    [SMBSessionRegistry sharedRegistry].idleTimeout = idleSessionTimeout;
+}
+
+- (NSUInteger)bufferMemoryLimit {
+    return _bufferPool.memoryLimit;
+}
+
+- (void)setBufferMemoryLimit:(NSUInteger)bufferMemoryLimit {
+    _bufferPool.memoryLimit = bufferMemoryLimit;
+}
+
+- (void)setKeepAliveInterval:(NSTimeInterval)keepAliveInterval {
+    @synchronized (self) {
+        _keepAliveInterval = keepAliveInterval;
+        
+        if (_keepAliveTimer) {
+            dispatch_source_cancel(_keepAliveTimer);
+            _keepAliveTimer = nil;
+        }
+        
+        if (keepAliveInterval > 0) {
+            // Checking twice per interval keeps sessions from being idle much longer
+            uint64_t period = (uint64_t)(keepAliveInterval / 2 * NSEC_PER_SEC);
+            __weak SMBFileServer *weakSelf = self;
+            
+            _keepAliveTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _serialQueue);
+            dispatch_source_set_timer(_keepAliveTimer, dispatch_time(DISPATCH_TIME_NOW, period), period, period / 10);
+            dispatch_source_set_event_handler(_keepAliveTimer, ^{
+                [weakSelf _keepAlive];
+            });
+            dispatch_resume(_keepAliveTimer);
+        }
+    }
+}
+
+- (SMBMetrics *)metrics {
+    return [_metricsRecorder snapshot];
+}
+
+- (void)resetMetrics {
+    [_metricsRecorder reset];
+}
+
+- (BOOL)signpostsEnabled {
+    return _metricsRecorder.signpostsEnabled;
+}
+
+- (void)setSignpostsEnabled:(BOOL)signpostsEnabled {
+    _metricsRecorder.signpostsEnabled = signpostsEnabled;
+}
+
+- (void)dispatchCompletion:(dispatch_block_t)block {
+    if (self.directCompletions) {
+        block();
+    } else {
+        dispatch_async(self.completionQueue ?: dispatch_get_main_queue(), block);
+    }
+}
+
 - (void)connectAsUser:(NSString *)username password:(NSString *)password completion:(void (^)(BOOL, NSError *))completion {
     [self connectAsUser:username password:password domain:nil completion:completion];
 }
@@ -65,94 +194,327 @@
 
         dispatch_async(self->_serialQueue, ^{
             
-            const char *name = self.netbiosName.UTF8String;
-            const char *host = self.host.UTF8String;
-            const char *user = username.length > 0 ? username.UTF8String : " ";
-            const char *pass = password.length > 0 ? password.UTF8String : " ";
-            const char *domn = domain.length > 0 ? domain.UTF8String : " ";
             NSError *error = nil;
             BOOL guest = NO;
-            const struct hostent *host_entry = gethostbyname(host);
             
-            if (host_entry == NULL) {
-                error = [SMBError hostNotFoundError];
-            } else if (host_entry->h_addr_list[0] == NULL) {
-                error = [SMBError noIPAddressError];
-            } else {
+            self->_username = username.length > 0 ? username : @" ";
+            self->_password = password.length > 0 ? password : @" ";
+            self->_domain = domain.length > 0 ? domain : @" ";
+            self->_sessionKey = [SMBSessionRegistry keyForHost:self.host domain:self->_domain username:self->_username password:self->_password];
+            self->_account = [NSString stringWithFormat:@"%@\\%@", self->_domain, self->_username];
+            
+            NSMutableDictionary<NSString *, NSNumber *> *shareIDs = [NSMutableDictionary dictionary];
+            
+            self->_smbSession = [self createSession:&error shareIDs:shareIDs];
+            
+            if (self->_smbSession) {
+                SMBSession *session = [[SMBSession alloc] initWithSession:self->_smbSession queue:self->_serialQueue server:self];
                 
-                self->_smbSession = smb_session_new();
+                if (smb_session_is_guest(self->_smbSession) > 0) {
+                    guest = YES;
+                }
                 
-                if (self->_smbSession) {
-                    const struct in_addr addr = *(struct in_addr *)host_entry->h_addr_list[0];
-                    
-                    smb_session_set_creds(self->_smbSession, domn, user, pass);
-                    
-                    // Connect to the host
-                    int result = smb_session_connect(self->_smbSession, name, addr.s_addr, SMB_TRANSPORT_TCP);
-                    
-                    if (result == 0) {
-                        // Login
-                        result = smb_session_login(self->_smbSession);
-                    }
-                    
-                    if (result == 0) {
-                        if (smb_session_is_guest(self->_smbSession) > 0) {
-                            guest = YES;
-                        }
-                    } else {
-                        error = [SMBError dsmError:result session:self->_smbSession];
-                        
-                        [self disconnect:nil];
-                    }
-                } else {
-                    error = [SMBError unknownError];
+                [shareIDs enumerateKeysAndObjectsUsingBlock:^(NSString *name, NSNumber *shareID, BOOL *stop) {
+                    [session setShareID:shareID.unsignedShortValue forShare:name];
+                }];
+                
+                @synchronized (self->_sessions) {
+                    [self->_sessions addObject:session];
                 }
+            } else {
+                self->_username = nil;
+                self->_sessionKey = nil;
+                self->_account = nil;
             }
             
             if (completion) {
-                dispatch_async(dispatch_get_main_queue(), ^{
+                [self dispatchCompletion:^{
                     completion(guest, error);
-                });
+                }];
             }
         });
     }];
     
 }
 
+- (smb_session *)createSession:(NSError **)error {
+    return [self createSession:error shareIDs:nil];
+}
+
+- (smb_session *)createSession:(NSError **)error shareIDs:(NSMutableDictionary<NSString *, NSNumber *> *)shareIDs {
+    smb_session *idleSession = [self _idleSession:shareIDs];
+    
+    if (idleSession) {
+        if (error) {
+            *error = nil;
+        }
+        return idleSession;
+    }
+    
+    const char *name = self.netbiosName.UTF8String;
+    smb_session *session = NULL;
+    NSError *err = nil;
+    NSArray<NSNumber *> *addresses = nil;
+    SMBResolver *resolver = [SMBResolver sharedResolver];
+    NSString *resolvedName = self.host;
+    
+    if (_username == nil) {
+        err = [SMBError notConnectedError];
+    } else {
+        addresses = [resolver addressesOfHost:resolvedName error:&err];
+        
+        // The host may be a NetBIOS name learned by discovery
+        if (addresses == nil && self.netbiosName.length > 0 && ![self.netbiosName isEqualToString:self.host]) {
+            resolvedName = self.netbiosName;
+            addresses = [resolver addressesOfHost:resolvedName error:nil];
+        }
+    }
+    
+    if (addresses) {
+        err = nil;
+        session = smb_session_new();
+        
+        if (session) {
+            // An address that just accepted a connection needn't be probed again
+            NSNumber *verified = [resolver verifiedAddressOfHost:resolvedName];
+            const in_addr_t addr = verified ? verified.unsignedIntValue : [resolver reachableAddress:addresses port:445 timeout:SMBFileServerConnectTimeout];
+            
+            smb_session_set_creds(session, _domain.UTF8String, _username.UTF8String, _password.UTF8String);
+            
+            // Connect to the host
+            uint64_t start = [_metricsRecorder begin:SMBOperationConnect];
+            int result = smb_session_connect(session, name, addr, SMB_TRANSPORT_TCP);
+            
+            [_metricsRecorder end:SMBOperationConnect start:start result:result];
+            
+            if (result == 0) {
+                [resolver preferAddress:addr forHost:resolvedName];
+                
+                // Login
+                start = [_metricsRecorder begin:SMBOperationLogin];
+                result = smb_session_login(session);
+                [_metricsRecorder end:SMBOperationLogin start:start result:result];
+            } else {
+                // The address may be stale, resolve again next time
+                [resolver removeAddressesOfHost:resolvedName];
+            }
+            
+            if (result != 0) {
+                err = [SMBError dsmError:result session:session];
+                
+                smb_session_destroy(session);
+                session = NULL;
+            }
+        } else {
+            err = [SMBError unknownError];
+        }
+    }
+    
+    if (error) {
+        *error = err;
+    }
+    
+    return session;
+}
+
+- (void)recycleSession:(smb_session *)session shareIDs:(NSDictionary<NSString *, NSNumber *> *)shareIDs {
+    NSString *key = _sessionKey;
+    
+    if (key) {
+        [[SMBSessionRegistry sharedRegistry] addSession:session shareIDs:shareIDs forKey:key];
+    } else {
+        smb_session_destroy(session);
+    }
+}
+
+- (smb_session *)keptSession:(NSMutableDictionary<NSString *, NSNumber *> *)shareIDs {
+    NSString *key = _sessionKey;
+    NSDictionary<NSString *, NSNumber *> *keptShareIDs = nil;
+    smb_session *session = key ? [_keptSessions takeSessionForKey:key shareIDs:&keptShareIDs] : NULL;
+    
+    if (session && keptShareIDs) {
+        [shareIDs addEntriesFromDictionary:keptShareIDs];
+    }
+    
+    return session;
+}
+
+- (void)keepSession:(smb_session *)session shareIDs:(NSDictionary<NSString *, NSNumber *> *)shareIDs {
+    NSString *key = _sessionKey;
+    
+    if (key) {
+        [_keptSessions addSession:session shareIDs:shareIDs forKey:key];
+    } else {
+        smb_session_destroy(session);
+    }
+}
+
+- (smb_session *)reconnectSession:(NSError **)error {
+    @synchronized (self) {
+        if (CFAbsoluteTimeGetCurrent() < _reconnectTime) {
+            if (error) {
+                *error = [SMBError notConnectedError];
+            }
+            return NULL;
+        }
+    }
+    
+    smb_session *session = [self createSession:error];
+    
+    @synchronized (self) {
+        if (session) {
+            _reconnectDelay = 0;
+        } else {
+            _reconnectDelay = MIN(MAX(2 * _reconnectDelay, 1), 60);
+            // Spread the attempts of clients that lost the server at the same time
+            _reconnectTime = CFAbsoluteTimeGetCurrent() + _reconnectDelay * (0.5 + arc4random_uniform(1000) / 1000.0);
+        }
+    }
+    
+    return session;
+}
+
+- (void)replaceSession:(smb_session *)session with:(smb_session *)newSession {
+    if (_smbSession == session) {
+        smb_session_destroy(_smbSession);
+        _smbSession = newSession;
+    }
+}
+
 - (void)disconnect:(nullable void (^)(void))completion {
     
     dispatch_async(_serialQueue, ^{
+        NSArray<SMBSession *> *sessions;
+        
+        @synchronized (self->_sessions) {
+            sessions = [self->_sessions copy];
+            [self->_sessions removeAllObjects];
+        }
+        
+        NSDictionary<NSString *, NSNumber *> *shareIDs = nil;
+        NSUInteger openFiles = 0;
+        
+        for (SMBSession *session in sessions) {
+            if (session.queue == self->_serialQueue) {
+                shareIDs = session.shareIDs;
+                openFiles = session.openFiles;
+                [session close];
+            } else {
+                dispatch_sync(session.queue, ^{
+                    [session close];
+                });
+            }
+        }
+        
+        [self _recycleKeptSessions];
+        
         if (self->_smbSession) {
-            smb_session_destroy(self->_smbSession);
+            // Files still open would keep their handles on a recycled session
+            if (openFiles == 0) {
+                [self recycleSession:self->_smbSession shareIDs:shareIDs];
+            } else {
+                smb_session_destroy(self->_smbSession);
+            }
             self->_smbSession = nil;
         }
         
+        self->_shareList = nil;
+        [self->_shareOpenCounts removeAllObjects];
+        [self->_idleShares removeAllObjects];
+        
+        NSArray<SMBShare *> *shares;
+        
+        @synchronized (self->_shares) {
+            shares = self->_shares.objectEnumerator.allObjects;
+        }
+        
+        for (SMBShare *share in shares) {
+            [share resetAfterDisconnect];
+        }
+        
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
+            [self dispatchCompletion:^{
                 completion();
-            });
+            }];
         }
     });
 }
 
+- (void)performOnSession:(void (^)(SMBSession *))block {
+    SMBSession *session = nil;
+    
+    @synchronized (_sessions) {
+        if (_sessions.count > 0) {
+            for (SMBSession *s in _sessions) {
+                if (s.pendingOperations == 0) {
+                    session = s;
+                    break;
+                }
+            }
+            
+            if (session == nil && _sessions.count < self.maxSessions) {
+                session = [[SMBSession alloc] initWithServer:self];
+                [_sessions addObject:session];
+            }
+            
+            if (session == nil) {
+                session = _sessions.firstObject;
+                
+                for (SMBSession *s in _sessions) {
+                    if (s.pendingOperations < session.pendingOperations) {
+                        session = s;
+                    }
+                }
+            }
+        }
+    }
+    
+    if (session) {
+        [session perform:block];
+    } else {
+        dispatch_async(_serialQueue, ^{
+            block(nil);
+        });
+    }
+}
+
 - (void)findShare:(nonnull NSString *)name completion:(nullable void (^)(SMBShare *_Nullable, NSError *_Nullable))completion {
     
-    [self listShares:^(NSArray<SMBShare *> *shares, NSError *error) {
+    dispatch_async(_serialQueue, ^{
         SMBShare *share = nil;
         
-        if (error == nil) {
-            for (SMBShare *s in shares) {
-                if ([s.name caseInsensitiveCompare:name] == NSOrderedSame) {
-                    share = s;
-                    break;
-                }
+        if (self.smbSession) {
+            @synchronized (self->_shares) {
+                share = [self->_shares objectForKey:name.lowercaseString];
             }
         }
         
-        if (completion) {
-            completion(share, error);
+        if (share) {
+            if (completion) {
+                [self dispatchCompletion:^{
+                    completion(share, nil);
+                }];
+            }
+            return;
         }
-    }];
+        
+        [self listShares:^(NSArray<SMBShare *> *shares, NSError *error) {
+            SMBShare *share = nil;
+            
+            if (error == nil) {
+                for (SMBShare *s in shares) {
+                    if ([s.name caseInsensitiveCompare:name] == NSOrderedSame) {
+                        share = s;
+                        break;
+                    }
+                }
+            }
+            
+            if (completion) {
+                completion(share, error);
+            }
+        }];
+    });
 }
 
 - (void)listShares:(nullable void (^)(NSArray<SMBShare *> *_Nullable, NSError *_Nullable))completion {
@@ -161,42 +523,20 @@
         
         NSMutableArray *shares = nil;
         NSError *error = nil;
-        smb_share_list list;
-        size_t shareCount = 0;
+        NSArray<NSString *> *names = [self _shareNames:&error];
         
-        if (self.smbSession) {
-            int dsm_error = smb_share_get_list(self.smbSession, &list, &shareCount);
+        if (names) {
+            shares = [NSMutableArray array];
             
-            if (dsm_error == 0) {
-                
-                shares = [NSMutableArray array];
-                
-                for (NSInteger i = 0; i < shareCount; i++) {
-                    const char *cname = smb_share_list_at(list, i);
-                    
-                    // Exclude system shares suffixed by '$'
-                    if (cname[strlen(cname) - 1] != '$') {
-                        
-                        NSString *shareName = [NSString stringWithUTF8String:cname];
-                        
-                        SMBShare *share = [[SMBShare alloc] initWithName:shareName server:self];
-                        
-                        [shares addObject:share];
-                    }
-                }
-                
-                smb_share_list_destroy(list);
-            } else {
-                error = [SMBError dsmError:dsm_error session:self.smbSession];
+            for (NSString *shareName in names) {
+                [shares addObject:[self _shareNamed:shareName]];
             }
-        } else {
-            error = [SMBError notConnectedError];
         }
         
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
+            [self dispatchCompletion:^{
                 completion(shares, error);
-            });
+            }];
         }
     });
 }
@@ -207,10 +547,18 @@
         NSError *error = nil;
         
         if (self.smbSession) {
-            int dsm_error = smb_tree_connect(self.smbSession, name.UTF8String, &shareID);
+            SMBSession *session;
+            
+            @synchronized (self->_sessions) {
+                session = self->_sessions.firstObject;
+            }
+            
+            // Reuses a tree that is still connected
+            shareID = [session shareIDForShare:name error:&error];
             
-            if (dsm_error != 0) {
-                error = [SMBError dsmError:dsm_error session:self.smbSession];
+            if (error == nil) {
+                self->_shareOpenCounts[name] = @(self->_shareOpenCounts[name].unsignedIntegerValue + 1);
+                [self->_idleShares removeObjectForKey:name];
             }
             
         } else {
@@ -218,22 +566,40 @@
         }
         
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(shareID, error);
-            });
+            completion(shareID, error);
         }
     });
 }
 
-- (void)closeShare:(smb_tid)shareID completion:(nullable void (^)(NSError * _Nullable))completion {
+- (void)closeShare:(nonnull NSString *)name completion:(nullable void (^)(NSError * _Nullable))completion {
     dispatch_async(_serialQueue, ^{
         NSError *error = nil;
         
         if (self.smbSession) {
-            int dsm_error = smb_tree_disconnect(self.smbSession, shareID);
+            NSUInteger openCount = self->_shareOpenCounts[name].unsignedIntegerValue;
+            NSTimeInterval idleShareTimeout = self.idleShareTimeout;
             
-            if (dsm_error != 0) {
-                error = [SMBError dsmError:dsm_error session:self.smbSession];
+            if (openCount > 1) {
+                self->_shareOpenCounts[name] = @(openCount - 1);
+            } else if (idleShareTimeout > 0) {
+                NSObject *token = [NSObject new];
+                __weak SMBFileServer *weakSelf = self;
+                
+                [self->_shareOpenCounts removeObjectForKey:name];
+                self->_idleShares[name] = token;
+                
+                // Disconnects unless the share was opened again meanwhile
+                dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(idleShareTimeout * NSEC_PER_SEC)), self->_serialQueue, ^{
+                    SMBFileServer *server = weakSelf;
+                    
+                    if (server && server->_idleShares[name] == token) {
+                        [server->_idleShares removeObjectForKey:name];
+                        [server _disconnectShare:name];
+                    }
+                });
+            } else {
+                [self->_shareOpenCounts removeObjectForKey:name];
+                error = [self _disconnectShare:name];
             }
             
         } else {
@@ -241,11 +607,153 @@
         }
         
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(error);
-            });
+            completion(error);
         }
     });
 }
 
+#pragma mark - Private methods
+
+// The tree may have been connected again since the share was opened, the
+// sessions know its current ID
+- (NSError *)_disconnectShare:(NSString *)name {
+    NSArray<SMBSession *> *sessions;
+    NSError *error = nil;
+    
+    @synchronized (_sessions) {
+        sessions = [_sessions copy];
+    }
+    
+    for (SMBSession *session in sessions) {
+        if (session.queue == _serialQueue) {
+            error = [session disconnectShare:name];
+        } else {
+            [session perform:^(SMBSession *s) {
+                [s disconnectShare:name];
+            }];
+        }
+    }
+    
+    return error;
+}
+
+// The names of the shares, without system shares, from the server or the cache
+- (NSArray<NSString *> *)_shareNames:(NSError **)error {
+    NSTimeInterval lifetime = self.shareListLifetime;
+    NSArray<NSString *> *names = nil;
+    NSError *err = nil;
+    smb_share_list list;
+    size_t shareCount = 0;
+    
+    if (_shareList && lifetime > 0 && CFAbsoluteTimeGetCurrent() - _shareListTime < lifetime) {
+        names = _shareList;
+    } else if (self.smbSession) {
+        int dsm_error = smb_share_get_list(self.smbSession, &list, &shareCount);
+        
+        if (dsm_error == 0) {
+            
+            NSMutableArray<NSString *> *shareNames = [NSMutableArray array];
+            
+            for (NSInteger i = 0; i < shareCount; i++) {
+                const char *cname = smb_share_list_at(list, i);
+                
+                // Exclude system shares suffixed by '$'
+                if (cname[strlen(cname) - 1] != '$') {
+                    [shareNames addObject:[NSString stringWithUTF8String:cname]];
+                }
+            }
+            
+            smb_share_list_destroy(list);
+            
+            names = shareNames;
+            _shareList = names;
+            _shareListTime = CFAbsoluteTimeGetCurrent();
+        } else {
+            err = [SMBError dsmError:dsm_error session:self.smbSession];
+        }
+    } else {
+        err = [SMBError notConnectedError];
+    }
+    
+    if (error) {
+        *error = err;
+    }
+    
+    return names;
+}
+
+// The share handed out before under this name, or a new one
+- (SMBShare *)_shareNamed:(NSString *)name {
+    @synchronized (_shares) {
+        SMBShare *share = [_shares objectForKey:name.lowercaseString];
+        
+        if (share == nil) {
+            share = [[SMBShare alloc] initWithName:name server:self];
+            [_shares setObject:share forKey:name.lowercaseString];
+        }
+        
+        return share;
+    }
+}
+
+- (void)_keepAlive {
+    NSArray<SMBSession *> *sessions;
+    
+    @synchronized (_sessions) {
+        sessions = [_sessions copy];
+    }
+    
+    for (SMBSession *session in sessions) {
+        if (session.pendingOperations == 0) {
+            [session perform:^(SMBSession *s) {
+                [s keepAlive];
+            }];
+        }
+    }
+}
+
+// Leaves the sessions kept for transfers to the registry, for other servers
+- (void)_recycleKeptSessions {
+    NSString *key = _sessionKey;
+    NSDictionary<NSString *, NSNumber *> *shareIDs = nil;
+    smb_session *session = NULL;
+    
+    while (key && (session = [_keptSessions takeSessionForKey:key shareIDs:&shareIDs])) {
+        [self recycleSession:session shareIDs:shareIDs];
+    }
+    [_keptSessions removeAllSessions];
+}
+
+// Takes over a session left in the registry by another server or an earlier
+// connect, if the server still knows it
+- (smb_session *)_idleSession:(NSMutableDictionary<NSString *, NSNumber *> *)shareIDs {
+    NSString *key = _sessionKey;
+    SMBSessionRegistry *registry = [SMBSessionRegistry sharedRegistry];
+    NSDictionary<NSString *, NSNumber *> *idleShareIDs = nil;
+    smb_session *session = NULL;
+    
+    if (_username == nil || key == nil) {
+        return NULL;
+    }
+    
+    while ((session = [registry takeSessionForKey:key shareIDs:&idleShareIDs])) {
+        if ([SMBSession probeSession:session] == 0) {
+            break;
+        }
+        smb_session_destroy(session);
+    }
+    
+    if (session) {
+        [idleShareIDs enumerateKeysAndObjectsUsingBlock:^(NSString *name, NSNumber *shareID, BOOL *stop) {
+            if (shareIDs) {
+                shareIDs[name] = shareID;
+            } else {
+                smb_tree_disconnect(session, shareID.unsignedShortValue);
+            }
+        }];
+    }
+    
+    return session;
+}
+
 @end
@@ -0,0 +1,85 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <Foundation/Foundation.h>
+
+typedef NS_ENUM(NSUInteger, SMBOperation) {
+    SMBOperationConnect,
+    SMBOperationLogin,
+    SMBOperationTreeConnect,
+    SMBOperationFind,
+    SMBOperationStat,
+    SMBOperationOpen,
+    SMBOperationRead,
+    SMBOperationWrite,
+    SMBOperationClose
+};
+
+// The number of operations tracked, for iterating over them
+extern const NSUInteger SMBOperationCount;
+
+// What was recorded for one kind of operation
+@interface SMBOperationMetrics : NSObject
+
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly) NSUInteger failures;
+@property (nonatomic, readonly) NSUInteger inFlight;
+@property (nonatomic, readonly) unsigned long long bytes;
+@property (nonatomic, readonly) NSTimeInterval totalDuration;
+@property (nonatomic, readonly) NSTimeInterval maximumDuration;
+// The number of durations up to each of the bounds of SMBMetrics
+@property (nonatomic, readonly, nonnull) NSArray<NSNumber *> *histogram;
+
+// An upper estimate of the duration the given fraction of operations didn't
+// exceed, e.g. 0.99 for the 99th percentile
+- (NSTimeInterval)durationAtPercentile:(double)percentile;
+
+#pragma mark - Unavailable methods
+
++ new NS_UNAVAILABLE;
+- init NS_UNAVAILABLE;
+
+@end
+
+// A snapshot of the time spent in requests to the server and in waiting for a
+// queue, and of the bytes transferred
+@interface SMBMetrics : NSObject
+
+@property (nonatomic, readonly, nonnull) NSDate *date;
+// The time operations waited for their turn on the queues of the object
+@property (nonatomic, readonly, nonnull) SMBOperationMetrics *queueWait;
+@property (nonatomic, readonly) unsigned long long bytesRead;
+@property (nonatomic, readonly) unsigned long long bytesWritten;
+
+// The upper bounds of the histogram buckets in seconds, the last is infinite
++ (nonnull NSArray<NSNumber *> *)histogramBounds;
+
+- (nonnull SMBOperationMetrics *)metricsForOperation:(SMBOperation)operation;
+
+#pragma mark - Unavailable methods
+
++ new NS_UNAVAILABLE;
+- init NS_UNAVAILABLE;
+
+@end
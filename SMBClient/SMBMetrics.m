@@ -0,0 +1,121 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import "SMBMetrics.h"
+#import "SMBMetricsRecorder.h"
+
+const NSUInteger SMBOperationCount = SMBOperationClose + 1;
+
+@implementation SMBOperationMetrics
+
+- (instancetype)initWithCount:(NSUInteger)count failures:(NSUInteger)failures inFlight:(NSUInteger)inFlight bytes:(unsigned long long)bytes totalDuration:(NSTimeInterval)totalDuration maximumDuration:(NSTimeInterval)maximumDuration histogram:(NSArray<NSNumber *> *)histogram {
+    self = [super init];
+    if (self) {
+        _count = count;
+        _failures = failures;
+        _inFlight = inFlight;
+        _bytes = bytes;
+        _totalDuration = totalDuration;
+        _maximumDuration = maximumDuration;
+        _histogram = histogram;
+    }
+    return self;
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"%lu (%lu failed, %lu in flight), %llu bytes, %.3f s, max. %.3f s, p99 %.3f s", (unsigned long)_count, (unsigned long)_failures, (unsigned long)_inFlight, _bytes, _totalDuration, _maximumDuration, [self durationAtPercentile:0.99]];
+}
+
+- (NSTimeInterval)durationAtPercentile:(double)percentile {
+    NSArray<NSNumber *> *bounds = [SMBMetrics histogramBounds];
+    double rank = _count * MIN(MAX(percentile, 0), 1);
+    NSUInteger sum = 0;
+    
+    if (_count == 0) {
+        return 0;
+    }
+    
+    for (NSUInteger i = 0; i < _histogram.count; i++) {
+        sum += _histogram[i].unsignedIntegerValue;
+        
+        if (sum >= rank) {
+            return MIN(bounds[i].doubleValue, _maximumDuration);
+        }
+    }
+    
+    return _maximumDuration;
+}
+
+@end
+
+@implementation SMBMetrics {
+    NSArray<SMBOperationMetrics *> *_operations;
+}
+
++ (NSArray<NSNumber *> *)histogramBounds {
+    static NSArray<NSNumber *> *bounds;
+    static dispatch_once_t onceToken;
+    
+    dispatch_once(&onceToken, ^{
+        bounds = @[@0.0001, @0.00025, @0.0005, @0.001, @0.0025, @0.005, @0.01, @0.025, @0.05, @0.1, @0.25, @0.5, @1, @2.5, @5, @10, @(INFINITY)];
+    });
+    
+    return bounds;
+}
+
+- (instancetype)initWithOperations:(NSArray<SMBOperationMetrics *> *)operations queueWait:(SMBOperationMetrics *)queueWait {
+    self = [super init];
+    if (self) {
+        _date = [NSDate date];
+        _operations = operations;
+        _queueWait = queueWait;
+    }
+    return self;
+}
+
+- (NSString *)description {
+    NSArray<NSString *> *names = @[@"connect", @"login", @"tree connect", @"find", @"stat", @"open", @"read", @"write", @"close"];
+    NSMutableString *description = [NSMutableString stringWithFormat:@"Metrics of %@", _date];
+    
+    for (NSUInteger i = 0; i < _operations.count; i++) {
+        [description appendFormat:@"\n%@: %@", names[i], _operations[i]];
+    }
+    [description appendFormat:@"\nqueue wait: %@", _queueWait];
+    
+    return description;
+}
+
+- (unsigned long long)bytesRead {
+    return _operations[SMBOperationRead].bytes;
+}
+
+- (unsigned long long)bytesWritten {
+    return _operations[SMBOperationWrite].bytes;
+}
+
+- (SMBOperationMetrics *)metricsForOperation:(SMBOperation)operation {
+    return _operations[operation];
+}
+
+@end
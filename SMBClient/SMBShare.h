@@ -26,17 +26,61 @@
 
 @class SMBFile;
 @class SMBFileServer;
+@class SMBMetrics;
 
 @interface SMBShare : NSObject
 
 @property (nonatomic, readonly, nonnull) SMBFileServer *server;
 @property (nonatomic, readonly, nonnull) NSString *name;
 @property (nonatomic, readonly) BOOL isOpen;
+// The queue completion and progress blocks of this share and its files are called
+// on. Defaults to nil, which is the completion queue of the server.
+@property (nonatomic, nullable) dispatch_queue_t completionQueue;
 
+// Status and directory contents fetched from the server are reused for this many
+// seconds. Changes made through this share invalidate them. Defaults to 0, which
+// disables the cache.
+@property (nonatomic) NSTimeInterval metadataCacheLifetime;
+
+// When set, closing a file that was opened for writing and creating a directory
+// don't read the status from the server afterwards. Such files have no status
+// until it's explicitly updated.
+@property (nonatomic) BOOL lazyStatus;
+
+// Files read completely or downloaded are kept on disk up to this many bytes, and
+// read from there as long as their size and modification time on the server don't
+// change. Defaults to 0, which disables the cache. The copies stay on disk when the
+// cache is disabled, until removeContentCache is called. Each account that connects
+// to the server has copies of its own.
+@property (atomic) unsigned long long contentCacheSize;
+
+// Latencies, queue waits and bytes transferred of this share and its files
+@property (nonatomic, readonly, nonnull) SMBMetrics *metrics;
+
+// Shares are reused by the server, so several users may open the same share. It
+// stays open until each open has been balanced by a close.
 - (void)open:(nullable void (^)(NSError *_Nullable error))completion;
 - (void)close:(nullable void (^)(NSError *_Nullable error))completion;
 - (void)listFiles:(nullable void (^)(NSArray<SMBFile *> *_Nullable files, NSError *_Nullable error))completion;
 - (void)listFilesUsingFilter:(nullable BOOL (^)(SMBFile *_Nonnull file))filter completion:(nullable void (^)(NSArray<SMBFile *> *_Nullable files, NSError *_Nullable error))completion;
+// Lists the root directory in batches of up to `batchSize` files. Only a few batches
+// are held back while `progress` is busy. Return NO from `progress` to stop early.
+// `progress` is called with `complete` set exactly once, even after stopping early.
+- (void)listFiles:(NSUInteger)batchSize filter:(nullable BOOL (^)(SMBFile *_Nonnull file))filter progress:(nullable BOOL (^)(NSArray<SMBFile *> *_Nullable files, BOOL complete, NSError *_Nullable error))progress;
+// Lists all files of the share, directory by directory, breadth first. Up to
+// `concurrency` directories are searched at a time, as far as maxSessions of the
+// server allows. `filter` selects the files reported, directories are always
+// searched. A directory that can't be searched is skipped, and the error reported
+// with `complete`, which is passed exactly once, also after stopping early.
+- (void)listFilesRecursively:(NSUInteger)concurrency filter:(nullable BOOL (^)(SMBFile *_Nonnull file))filter progress:(nullable BOOL (^)(NSArray<SMBFile *> *_Nullable files, BOOL complete, NSError *_Nullable error))progress;
+// Creates all directories of `paths`, including missing parents. Parents that paths
+// have in common are only created once.
+- (void)createDirectoriesAtPaths:(nonnull NSArray<NSString *> *)paths completion:(nullable void (^)(NSArray<SMBFile *> *_Nullable files, NSError *_Nullable error))completion;
+- (void)invalidateMetadataCache;
+- (void)invalidateMetadataCacheForPath:(nonnull NSString *)path;
+// Removes the copies of files kept on disk
+- (void)removeContentCache;
+- (void)resetMetrics;
 
 #pragma mark - Unavailable methods
 
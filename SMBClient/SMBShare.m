@@ -25,19 +25,58 @@
 #import "SMBShare_Protected.h"
 #import "SMBError.h"
 #import "SMBFile_Protected.h"
+#import "SMBSession.h"
+#import "SMBMetadataCache.h"
+#import "SMBContentCache.h"
+#import "SMBTransferRecord.h"
+#import "SMBMetricsRecorder.h"
+#import "SMBBufferPool.h"
 
 #import "smb_share.h"
 #import "smb_dir.h"
 #import "smb_file.h"
 #import "smb_stat.h"
 
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/stat.h>
+
 @interface SMBShare ()
 
 @property (nonatomic) dispatch_queue_t serialQueue;
 @property (nonatomic) smb_tid shareID;
+@property (nonatomic) NSUInteger openCount;
+@property (nonatomic) SMBMetadataCache *metadataCache;
+
+- (void)_performOnSession:(SMBSession *)session block:(void (^)(SMBSession *session, smb_tid shareID, NSError *error))block;
+
+@end
+
+// Runs an operation for each item added, on the sessions of the server and up to
+// a number of them at a time. Everything but the operation itself happens on the
+// queue given.
+@interface SMBSharePipeline : NSObject
+
+// Called for each item that was processed without error. Returning NO cancels the
+// items that haven't started yet.
+@property (nonatomic, copy) BOOL (^itemCompletion)(id item, NSError *error);
+@property (nonatomic, readonly) BOOL cancelled;
+
+- (instancetype)initWithShare:(SMBShare *)share concurrency:(NSUInteger)concurrency queue:(dispatch_queue_t)queue operation:(NSError *(^)(id item, SMBSession *session, smb_tid shareID))operation;
+
+- (void)addItem:(id)item;
+
+// Calls the completion once all items added are processed, or the first one failed
+- (void)drain:(void (^)(NSError *error))completion;
 
 @end
 
+// The number of batches of a listing that may wait for the consumer
+static const NSUInteger SMBMaximumPendingBatches = 4;
+
+// Resumable transfers record their progress every time this many bytes are done
+static const unsigned long long SMBTransferRecordInterval = 8 * 1024 * 1024;
+
 @implementation SMBShare
 
 - (nullable instancetype)initWithName:(nonnull NSString *)name server:(nonnull SMBFileServer *)server {
@@ -49,6 +88,8 @@
         _server = server;
         _shareID = 0;
         _serialQueue = dispatch_queue_create(queueName.UTF8String, DISPATCH_QUEUE_SERIAL);
+        _metadataCache = [SMBMetadataCache new];
+        _metricsRecorder = [[SMBMetricsRecorder alloc] initWithParent:server.metricsRecorder];
     }
     return self;
 }
@@ -66,10 +107,15 @@
     dispatch_async(_serialQueue, ^{
         [self.server openShare:self.name completion:^(smb_tid shareID, NSError *error){
             if (error == nil) {
-                self->_shareID = shareID;
+                @synchronized (self) {
+                    self->_shareID = shareID;
+                    self->_openCount++;
+                }
             }
             if (completion) {
-                completion(error);
+                [self dispatchCompletion:^{
+                    completion(error);
+                }];
             }
         }];
     });
@@ -77,13 +123,39 @@
 
 - (void)close:(nullable void (^)(NSError *_Nullable))completion {
     dispatch_async(_serialQueue, ^{
-        if (self->_shareID == 0) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion([SMBError notOpenError]);
-            });
+        BOOL open = NO;
+        BOOL closed = NO;
+        
+        // The share may be opened by several users, it's closed by the last one
+        @synchronized (self) {
+            if (self->_openCount > 0) {
+                open = YES;
+                closed = --self->_openCount == 0;
+                
+                if (closed) {
+                    self->_shareID = 0;
+                }
+            }
+        }
+        
+        if (!open) {
+            if (completion) {
+                [self dispatchCompletion:^{
+                    completion([SMBError notOpenError]);
+                }];
+            }
         } else {
-            [self.server closeShare:self->_shareID completion:completion];
-            self->_shareID = 0;
+            if (closed) {
+                [self.metadataCache invalidateAll];
+            }
+            
+            [self.server closeShare:self.name completion:^(NSError *error) {
+                if (completion) {
+                    [self dispatchCompletion:^{
+                        completion(error);
+                    }];
+                }
+            }];
         }
     });
 }
@@ -92,102 +164,168 @@
     return _shareID > 0;
 }
 
+- (void)resetAfterDisconnect {
+    @synchronized (self) {
+        _openCount = 0;
+        _shareID = 0;
+    }
+    
+    [self.metadataCache invalidateAll];
+}
+
+- (void)dispatchCompletion:(dispatch_block_t)block {
+    dispatch_queue_t queue = self.completionQueue;
+    
+    if (queue) {
+        dispatch_async(queue, block);
+    } else {
+        [self.server dispatchCompletion:block];
+    }
+}
+
+- (NSTimeInterval)metadataCacheLifetime {
+    return _metadataCache.lifetime;
+}
+
+- (void)setMetadataCacheLifetime:(NSTimeInterval)metadataCacheLifetime {
+    _metadataCache.lifetime = metadataCacheLifetime;
+    
+    if (metadataCacheLifetime <= 0) {
+        [_metadataCache invalidateAll];
+    }
+}
+
+// Shares of the same host, name and account use the same copies, within the size
+// set on the share that used them last
+- (SMBContentCache *)contentCache {
+    SMBContentCache *cache = [SMBContentCache cacheWithDirectory:[self _contentCacheDirectory]];
+    
+    cache.sizeLimit = self.contentCacheSize;
+    
+    return cache;
+}
+
+- (void)removeContentCache {
+    [self.contentCache removeAll];
+}
+
+- (SMBMetrics *)metrics {
+    return [_metricsRecorder snapshot];
+}
+
+- (void)resetMetrics {
+    [_metricsRecorder reset];
+}
+
+- (void)invalidateMetadataCache {
+    [_metadataCache invalidateAll];
+}
+
+- (void)invalidateMetadataCacheForPath:(NSString *)path {
+    [_metadataCache invalidatePath:path];
+}
+
 - (void)createDirectories:(nonnull NSString *)path completion:(nullable void (^)(SMBFile *_Nullable, NSError *_Nullable))completion {
-    dispatch_async(_serialQueue, ^{
+    [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
         SMBFile *file = nil;
-        NSError *error = nil;
         
-        if (self.server.smbSession) {
-            if ([self isOpen]) {
-                NSString *p = path;
+        if (error == nil) {
+            NSArray<NSString *> *directories = [self _smbPathsOfDirectories:path];
+            
+            if (directories.count > 0) {
+                error = [self _createDirectories:directories existing:[NSMutableSet set] session:session shareID:shareID];
                 
-                while ([p hasPrefix:@"/"]) {
-                    p = [path substringFromIndex:1];
+                if (error == nil) {
+                    file = [self _createdDirectory:path session:session shareID:shareID];
                 }
-                NSArray *directories = p.pathComponents;
-                
-                p = @"";
+            }
+        }
+        
+        if (completion) {
+            [self dispatchCompletion:^{
+                completion(file, error);
+            }];
+        }
+    }];
+}
+
+- (void)createDirectoriesAtPaths:(NSArray<NSString *> *)paths completion:(nullable void (^)(NSArray<SMBFile *> *_Nullable, NSError *_Nullable))completion {
+    [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
+        NSMutableArray<SMBFile *> *files = nil;
+        
+        if (error == nil) {
+            // Parents sort before their children, so common parents are created once
+            NSArray<NSString *> *sortedPaths = [paths sortedArrayUsingSelector:@selector(caseInsensitiveCompare:)];
+            NSMutableSet<NSString *> *existing = [NSMutableSet set];
+            
+            files = [NSMutableArray arrayWithCapacity:paths.count];
+            
+            for (NSString *path in sortedPaths) {
+                NSArray<NSString *> *directories = [self _smbPathsOfDirectories:path];
                 
-                for (NSUInteger i = 0; error == nil && i < directories.count; i++) {
-                    p = [p stringByAppendingFormat:@"\\%@", [directories objectAtIndex:i]];
-                    
-                    const char *cpath = p.UTF8String;
-                    SMBStat *stat = [self _stat:cpath];
+                if (directories.count > 0) {
+                    error = [self _createDirectories:directories existing:existing session:session shareID:shareID];
                     
-                    if (!stat.exists) {
-                        int dsm_error = smb_directory_create(self.server.smbSession, self->_shareID, cpath);
-                        
-                        if (dsm_error != 0) {
-                            error = [SMBError dsmError:dsm_error session:self.server.smbSession];
-                        }
+                    if (error) {
+                        files = nil;
+                        break;
                     }
                     
-                    if (error == nil && i == directories.count - 1) {
-                        file = [[SMBFile alloc] initWithPath:path share:self];
-                        
-                        if (!stat.exists) {
-                            stat = [self _stat:cpath];
-                        }
-                        file.smbStat = stat;
-                    }
+                    [files addObject:[self _createdDirectory:path session:session shareID:shareID]];
                 }
-                
-            } else {
-                error = [SMBError notOpenError];
             }
-        } else {
-            error = [SMBError notConnectedError];
         }
         
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(file, error);
-            });
+            [self dispatchCompletion:^{
+                completion(files, error);
+            }];
         }
-    });
+    }];
 }
 
 - (void)createDirectory:(nonnull NSString *)path completion:(nullable void (^)(SMBFile *_Nullable, NSError *_Nullable))completion {
-    dispatch_async(_serialQueue, ^{
+    [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
         SMBFile *file = nil;
-        NSError *error = nil;
         
-        if (self.server.smbSession) {
-            if ([self isOpen]) {
-                
-                NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
-                const char *cpath = smbPath.UTF8String;
-                SMBStat *stat = [self _stat:cpath];
+        if (error == nil) {
+            NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+            const char *cpath = smbPath.UTF8String;
+            SMBStat *stat = nil;
+            NSUInteger generation = self.metadataCache.generation;
+            
+            // Just try it, the server tells us if it's already there
+            int dsm_error = smb_directory_create(session.smbSession, shareID, cpath);
+            
+            if (dsm_error == 0) {
+                [self.metadataCache invalidatePath:path];
+                generation = self.metadataCache.generation;
                 
-                if (!stat.exists) {
-                    int dsm_error = smb_directory_create(self.server.smbSession, self->_shareID, cpath);
-                    
-                    if (dsm_error != 0) {
-                        error = [SMBError dsmError:dsm_error session:self.server.smbSession];
-                    }
+                if (!self.lazyStatus) {
+                    stat = [self _findStat:cpath session:session shareID:shareID];
                 }
+            } else if ([self _isNTStatus:NT_STATUS_OBJECT_NAME_COLLISION error:dsm_error session:session]) {
+                stat = [self _stat:cpath session:session shareID:shareID];
+            } else {
+                error = [SMBError dsmError:dsm_error session:session.smbSession];
+            }
+            
+            if (error == nil) {
+                file = [[SMBFile alloc] initWithPath:path share:self];
+                file.smbStat = stat;
                 
-                if (error == nil) {
-                    file = [[SMBFile alloc] initWithPath:path share:self];
-                    
-                    if (!stat.exists) {
-                        stat = [self _stat:cpath];
-                    }
-                    file.smbStat = stat;
+                if (stat) {
+                    [self.metadataCache setStat:stat forPath:path generation:generation];
                 }
-            } else {
-                error = [SMBError notOpenError];
             }
-        } else {
-            error = [SMBError notConnectedError];
         }
         
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
+            [self dispatchCompletion:^{
                 completion(file, error);
-            });
+            }];
         }
-    });
+    }];
 }
 
 - (uint32_t)_mod:(SMBFileMode)mode {
@@ -203,114 +341,169 @@
     return mod;
 }
 
-- (void)openFile:(nonnull NSString *)path mode:(SMBFileMode)mode completion:(nullable void (^)(SMBFile *, smb_fd, NSError *_Nullable))completion {
+- (void)openFile:(nonnull NSString *)path mode:(SMBFileMode)mode metricsRecorder:(SMBMetricsRecorder *)metricsRecorder completion:(nullable void (^)(SMBFile *, SMBSession *, smb_fd, NSError *_Nullable))completion {
 
-    dispatch_async(_serialQueue, ^{
+    [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
 
         smb_fd fd = -1;
-        NSError *error = nil;
         SMBFile *file = nil;
         
-        if (self.server.smbSession) {
-            if ([self isOpen]) {
-                NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
-                const char *cpath = smbPath.UTF8String;
-                uint32_t mod = [self _mod:mode];
+        if (error == nil) {
+            NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+            const char *cpath = smbPath.UTF8String;
+            uint32_t mod = [self _mod:mode];
 
-                file = [[SMBFile alloc] initWithPath:path share:self];
-                file.smbStat = [self _stat:cpath];
+            NSUInteger generation = self.metadataCache.generation;
+
+            file = [[SMBFile alloc] initWithPath:path share:self];
+            
+            uint64_t start = [metricsRecorder begin:SMBOperationOpen];
+            int dsm_error = smb_fopen(session.smbSession, shareID, cpath, mod, &fd);
+            
+            [metricsRecorder end:SMBOperationOpen start:start result:dsm_error];
+            
+            if (dsm_error != 0) {
+                error = [SMBError dsmError:dsm_error session:session.smbSession];
+            } else {
+                [session addOpenFile];
                 
-                int dsm_error = smb_fopen(self.server.smbSession, self.shareID, cpath, mod, &fd);
+                // The server returns the status with the handle
+                smb_stat stat = smb_stat_fd(session.smbSession, fd);
                 
-                if (dsm_error != 0) {
-                    error = [SMBError dsmError:dsm_error session:self.server.smbSession];
-                }
-            } else {
-                error = [SMBError notOpenError];
+                file.smbStat = stat ? [SMBStat statWithStat:stat] : [self _stat:cpath session:session shareID:shareID];
+                [self.metadataCache setStat:file.smbStat forPath:path generation:generation];
             }
-        } else {
-            error = [SMBError notConnectedError];
         }
         
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(file, fd, error);
-            });
+            [self dispatchCompletion:^{
+                completion(file, session, fd, error);
+            }];
         }
-    });
+    }];
+}
+
+- (smb_fd)reopenFile:(NSString *)path mode:(SMBFileMode)mode session:(SMBSession *)session metricsRecorder:(SMBMetricsRecorder *)metricsRecorder error:(NSError **)error {
+    NSError *err = nil;
+    smb_fd fd = 0;
+    
+    if ([self isOpen]) {
+        smb_tid shareID = [session shareIDForShare:self.name error:&err];
+        
+        if (err == nil) {
+            NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+            uint64_t start = [metricsRecorder begin:SMBOperationOpen];
+            int dsm_error = smb_fopen(session.smbSession, shareID, smbPath.UTF8String, [self _mod:mode], &fd);
+            
+            [metricsRecorder end:SMBOperationOpen start:start result:dsm_error];
+            
+            if (dsm_error != 0) {
+                err = [SMBError dsmError:dsm_error session:session.smbSession];
+                fd = 0;
+            }
+        }
+    } else {
+        err = [SMBError notOpenError];
+    }
+    
+    if (fd == 0) {
+        // The file is left closed
+        [session removeOpenFile];
+    }
+    
+    if (error) {
+        *error = err;
+    }
+    
+    return fd;
 }
 
-- (void)closeFile:(smb_fd)fd path:(NSString *)path completion:(nullable void (^)(SMBFile *_Nullable, NSError *_Nullable))completion {
+- (void)closeFile:(smb_fd)fd path:(NSString *)path mode:(SMBFileMode)mode session:(SMBSession *)fileSession generation:(NSUInteger)sessionGeneration metricsRecorder:(SMBMetricsRecorder *)metricsRecorder completion:(nullable void (^)(SMBFile *_Nullable, NSError *_Nullable))completion {
 
-    dispatch_async(_serialQueue, ^{
+    [self _performOnSession:fileSession block:^(SMBSession *session, smb_tid shareID, NSError *error) {
 
-        NSError *error = nil;
         SMBFile *file = nil;
         
-        if (self.server.smbSession) {
-            if ([self isOpen]) {
+        if (error == nil) {
+            BOOL writable = (mode & SMBFileModeWrite) != 0;
+            // The handle went with the session it was opened on, if that was replaced
+            BOOL valid = session.generation == sessionGeneration;
+            SMBStat *stat = nil;
+            
+            if (valid && self.lazyStatus && !writable) {
+                // Nothing has changed since the file was opened
+                smb_stat openStat = smb_stat_fd(session.smbSession, fd);
                 
-                smb_fclose(self.server.smbSession, fd);
+                if (openStat) {
+                    stat = [SMBStat statWithStat:openStat];
+                }
+            }
+            
+            if (valid) {
+                uint64_t start = [metricsRecorder begin:SMBOperationClose];
                 
-                NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
-                const char *cpath = smbPath.UTF8String;
+                smb_fclose(session.smbSession, fd);
+                [metricsRecorder end:SMBOperationClose start:start result:0];
+            }
+            [session removeOpenFile];
+            
+            NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+            const char *cpath = smbPath.UTF8String;
+            
+            if (writable) {
+                [self.metadataCache invalidatePath:path];
+            }
+            
+            if (stat == nil && !(self.lazyStatus && writable)) {
+                NSUInteger generation = self.metadataCache.generation;
                 
-                file = [[SMBFile alloc] initWithPath:path share:self];
-                file.smbStat = [self _stat:cpath];
-
-            } else {
-                error = [SMBError notOpenError];
+                stat = [self _stat:cpath session:session shareID:shareID];
+                [self.metadataCache setStat:stat forPath:path generation:generation];
             }
-        } else {
-            error = [SMBError notConnectedError];
+            
+            file = [[SMBFile alloc] initWithPath:path share:self];
+            file.smbStat = stat;
         }
         
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
+            [self dispatchCompletion:^{
                 completion(file, error);
-            });
+            }];
         }
-    });
+    }];
 }
 
 - (void)deleteFile:(nonnull NSString *)path completion:(nullable void (^)(NSError *_Nullable))completion {
-    dispatch_async(_serialQueue, ^{
-        NSError *error = nil;
+    [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
         
-        if (self.server.smbSession) {
-            if ([self isOpen]) {
-                
-                NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
-                const char *cpath = smbPath.UTF8String;
-                SMBStat *stat = [self _stat:cpath];
+        if (error == nil) {
+            
+            NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+            const char *cpath = smbPath.UTF8String;
+            SMBStat *stat = [self _stat:cpath session:session shareID:shareID];
+            
+            if (stat.exists) {
+                int dsm_error = 0;
                 
-                if (stat.exists) {
-                    int dsm_error = 0;
-                    
-                    if (stat.isDirectory) {
-                        dsm_error = smb_directory_rm(self.server.smbSession, self->_shareID, cpath);
-                    } else {
-                        dsm_error = smb_file_rm(self.server.smbSession, self->_shareID, cpath);
-                    }
+                if (stat.isDirectory) {
+                    dsm_error = smb_directory_rm(session.smbSession, shareID, cpath);
+                } else {
+                    dsm_error = smb_file_rm(session.smbSession, shareID, cpath);
+                }
 
-                    if (dsm_error != 0) {
-                        error = [SMBError dsmError:dsm_error session:self.server.smbSession];
-                    }
+                if (dsm_error != 0) {
+                    error = [SMBError dsmError:dsm_error session:session.smbSession];
                 }
-                
-            } else {
-                error = [SMBError notOpenError];
             }
-        } else {
-            error = [SMBError notConnectedError];
+            [self.metadataCache invalidatePath:path];
         }
         
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
+            [self dispatchCompletion:^{
                 completion(error);
-            });
+            }];
         }
-    });
+    }];
 }
 
 - (void)listFiles:(void (^)(NSArray<SMBFile *> *, NSError *))completion {
@@ -323,158 +516,1308 @@
 
 - (void)listFiles:(NSString *)path filter:(nullable BOOL (^)(SMBFile *_Nonnull file))filter completion:(void (^)(NSArray<SMBFile *> *, NSError *))completion {
     
-    dispatch_async(_serialQueue, ^{
+    NSArray<SMBStat *> *cachedListing = self.isOpen ? [self.metadataCache listingForPath:path] : nil;
+    
+    if (cachedListing) {
+        dispatch_async(_serialQueue, ^{
+            NSArray<SMBFile *> *fileList = [self _files:cachedListing inDirectory:path filter:filter];
+            
+            if (completion) {
+                [self dispatchCompletion:^{
+                    completion(fileList, nil);
+                }];
+            }
+        });
+        return;
+    }
+    
+    [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
         
-        NSMutableArray *fileList = nil;
-        NSError *error = nil;
+        NSArray<SMBFile *> *fileList = nil;
         
-        if (self.server.smbSession) {
-            if ([self isOpen]) {
-                
-                NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
-                
-                if (![smbPath hasSuffix:@"\\"]) {
-                    smbPath = [smbPath stringByAppendingString:@"\\"];
-                }
-                smbPath = [smbPath stringByAppendingString:@"*"];
-                
-                //Query for a list of files in this directory
-                smb_stat_list statList = smb_find(self.server.smbSession, self->_shareID, smbPath.UTF8String);
+        if (error == nil) {
+            
+            //Query for a list of files in this directory
+            NSUInteger generation = self.metadataCache.generation;
+            uint64_t start = [self.metricsRecorder begin:SMBOperationFind];
+            smb_stat_list statList = smb_find(session.smbSession, shareID, [self _searchPattern:path].UTF8String);
+            
+            [self.metricsRecorder end:SMBOperationFind start:start result:statList ? 0 : -1];
+            
+            if (statList != NULL) {
+                size_t listCount = smb_stat_list_count(statList);
+                NSMutableArray<SMBStat *> *listing = [NSMutableArray arrayWithCapacity:listCount];
                 
-                if (statList != NULL) {
-                    size_t listCount = smb_stat_list_count(statList);
-                    
-                    fileList = [NSMutableArray array];
+                for (NSInteger i = 0; i < listCount; i++) {
+                    SMBStat *stat = [self _entryOfList:statList at:i];
                     
-                    for (NSInteger i = 0; i < listCount; i++) {
-                        smb_stat item = smb_stat_list_at(statList, i);
-                        const char *name = smb_stat_name(item);
-                        
-                        NSString *filePath = [path stringByAppendingPathComponent:[NSString stringWithUTF8String:name]];
-                        
-                        SMBFile *file = [[SMBFile alloc] initWithPath:filePath share:self];
-                        
-                        file.smbStat = [[SMBStat alloc] initWithStat:item];
-                        
-                        if (!(file.isDirectory && ([file.name isEqualToString:@".."] || [file.name isEqualToString:@"."]))) {
-                            if (filter == nil || filter(file)) {
-                                [fileList addObject:file];
-                            }
-                        }
+                    if (stat) {
+                        [listing addObject:stat];
                     }
-                    smb_stat_list_destroy(statList);
-                } else {
-                    /*
-                    uint32_t nt_status = smb_session_get_nt_status(self.server.smbSession);
-                    if (nt_status != NT_STATUS_SUCCESS) {
-                        error = [SMBError dsmError:DSM_ERROR_NT session:self.server.smbSession];
-                    }
-                    */
                 }
+                smb_stat_list_destroy(statList);
                 
+                [self.metadataCache setListing:listing forPath:path generation:generation];
+                
+                fileList = [self _files:listing inDirectory:path filter:filter];
             } else {
-                error = [SMBError notOpenError];
+                /*
+                uint32_t nt_status = smb_session_get_nt_status(session.smbSession);
+                if (nt_status != NT_STATUS_SUCCESS) {
+                    error = [SMBError dsmError:DSM_ERROR_NT session:session.smbSession];
+                }
+                */
             }
-        } else {
-            error = [SMBError notConnectedError];
         }
         
         if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
+            [self dispatchCompletion:^{
                 completion(fileList, error);
-            });
+            }];
         }
-    });
+    }];
 }
 
-- (void)moveFile:(NSString *)oldPath to:(NSString *)newPath completion:(void (^)(SMBFile *, NSError *))completion {
-    dispatch_async(_serialQueue, ^{
-        NSError *error = nil;
-        SMBFile *file = nil;
-        
-        if (self.server.smbSession) {
-            if ([self isOpen]) {
-                NSString *smbOldPath = [oldPath stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
-                NSString *smbNewPath = [newPath stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+- (void)listFiles:(NSUInteger)batchSize filter:(nullable BOOL (^)(SMBFile *_Nonnull))filter progress:(nullable BOOL (^)(NSArray<SMBFile *> *_Nullable, BOOL, NSError *_Nullable))progress {
+    [self listFiles:@"/" batchSize:batchSize filter:filter progress:progress];
+}
 
-                int res = smb_file_mv(self.server.smbSession, self->_shareID, smbOldPath.UTF8String, smbNewPath.UTF8String);
+- (void)listFiles:(NSString *)path batchSize:(NSUInteger)batchSize filter:(nullable BOOL (^)(SMBFile *_Nonnull))filter progress:(nullable BOOL (^)(NSArray<SMBFile *> *_Nullable, BOOL, NSError *_Nullable))progress {
+    
+    NSArray<SMBStat *> *cachedListing = self.isOpen ? [self.metadataCache listingForPath:path] : nil;
+    
+    if (cachedListing) {
+        dispatch_async(_serialQueue, ^{
+            [self _enumerate:cachedListing.count entries:^SMBStat *(NSUInteger index) {
+                return cachedListing[index];
+            } inDirectory:path batchSize:batchSize filter:filter progress:progress];
+        });
+        return;
+    }
+    
+    [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
+        
+        if (error == nil) {
+            NSUInteger generation = self.metadataCache.generation;
+            uint64_t start = [self.metricsRecorder begin:SMBOperationFind];
+            smb_stat_list statList = smb_find(session.smbSession, shareID, [self _searchPattern:path].UTF8String);
+            
+            [self.metricsRecorder end:SMBOperationFind start:start result:statList ? 0 : -1];
+            
+            if (statList != NULL) {
+                size_t listCount = smb_stat_list_count(statList);
                 
-                if (res != 0) {
-                    error = [SMBError notSuchFileOrDirectory];
-                } else {
-                    file = [SMBFile fileWithPath:newPath share:self];
-                    file.smbStat = [self _stat:smbNewPath.UTF8String];
+                // Only keep everything if it's worth it
+                NSMutableArray<SMBStat *> *listing = self.metadataCacheLifetime > 0 ? [NSMutableArray arrayWithCapacity:listCount] : nil;
+                
+                BOOL all = [self _enumerate:listCount entries:^SMBStat *(NSUInteger index) {
+                    SMBStat *stat = [self _entryOfList:statList at:index];
+                    
+                    if (stat) {
+                        [listing addObject:stat];
+                    }
+                    return stat;
+                } inDirectory:path batchSize:batchSize filter:filter progress:progress];
+                
+                smb_stat_list_destroy(statList);
+                
+                if (all && listing) {
+                    [self.metadataCache setListing:listing forPath:path generation:generation];
                 }
-            } else {
-                error = [SMBError notOpenError];
+                return;
             }
-        } else {
-            error = [SMBError notConnectedError];
         }
         
-        if (completion) {
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(file, error);
-            });
+        if (progress) {
+            [self dispatchCompletion:^{
+                progress(nil, YES, error);
+            }];
         }
-    });
+    }];
 }
 
-- (void)getStatusOfFile:(NSString *)path completion:(void (^)(SMBStat *, NSError *))completion {
+- (void)listFilesRecursively:(NSUInteger)concurrency filter:(nullable BOOL (^)(SMBFile *_Nonnull))filter progress:(nullable BOOL (^)(NSArray<SMBFile *> *_Nullable, BOOL, NSError *_Nullable))progress {
+    [self listFilesRecursively:@"/" concurrency:concurrency filter:filter progress:progress];
+}
 
-    if (path.length == 0 || [path isEqualToString:@"/"]) {
-        if (completion) {
-            completion([SMBStat statForRoot], nil);
+- (void)listFilesRecursively:(NSString *)path concurrency:(NSUInteger)concurrency filter:(nullable BOOL (^)(SMBFile *_Nonnull))filter progress:(nullable BOOL (^)(NSArray<SMBFile *> *_Nullable, BOOL, NSError *_Nullable))progress {
+    
+    dispatch_queue_t queue = dispatch_queue_create("smb_walk_queue", DISPATCH_QUEUE_SERIAL);
+    dispatch_semaphore_t pending = dispatch_semaphore_create(0);
+    NSObject *lock = [NSObject new];
+    __block BOOL stopped = NO;
+    
+    BOOL (^isStopped)(void) = ^BOOL{
+        @synchronized (lock) {
+            return stopped;
         }
-    } else {
-        dispatch_async(_serialQueue, ^{
-            NSError *error = nil;
-            SMBStat *smbStat = nil;
-            
-            if (self.server.smbSession) {
-                if ([self isOpen]) {
-                    NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
-                    smbStat = [self _stat:smbPath.UTF8String];
-                } else {
-                    error = [SMBError notOpenError];
-                }
-            } else {
-                error = [SMBError notConnectedError];
+    };
+    
+    // Results that weren't consumed yet hold back further searches
+    for (NSUInteger i = 0; i < 2 * MAX(concurrency, 1); i++) {
+        dispatch_semaphore_signal(pending);
+    }
+    
+    [self _walk:path concurrency:concurrency queue:queue visit:^BOOL(NSArray<SMBFile *> *files) {
+        NSMutableArray<SMBFile *> *selected = [NSMutableArray arrayWithCapacity:files.count];
+        
+        for (SMBFile *file in files) {
+            if (filter == nil || filter(file)) {
+                [selected addObject:file];
             }
+        }
+        
+        if (selected.count > 0) {
+            dispatch_semaphore_wait(pending, DISPATCH_TIME_FOREVER);
             
-            if (completion) {
-                dispatch_async(dispatch_get_main_queue(), ^{
-                    completion(smbStat, error);
-                });
+            [self dispatchCompletion:^{
+                if (!isStopped() && (progress == nil || !progress(selected, NO, nil))) {
+                    @synchronized (lock) {
+                        stopped = YES;
+                    }
+                }
+                dispatch_semaphore_signal(pending);
+            }];
+        }
+        
+        return !isStopped();
+    } completion:^(NSError *error) {
+        [self dispatchCompletion:^{
+            if (progress) {
+                progress(nil, YES, error);
+            }
+        }];
+    }];
+}
+
+- (void)deleteRecursively:(NSString *)path concurrency:(NSUInteger)concurrency progress:(nullable BOOL (^)(NSUInteger, unsigned long long, BOOL, NSError *_Nullable))progress {
+    
+    dispatch_queue_t queue = dispatch_queue_create("smb_bulk_queue", DISPATCH_QUEUE_SERIAL);
+    __block NSUInteger filesDeleted = 0;
+    __block unsigned long long bytesDeleted = 0;
+    NSObject *lock = [NSObject new];
+    __block BOOL stopped = NO;
+    
+    BOOL (^isStopped)(void) = ^BOOL{
+        @synchronized (lock) {
+            return stopped;
+        }
+    };
+    
+    BOOL (^deleted)(SMBFile *, NSError *) = ^BOOL(SMBFile *file, NSError *error) {
+        NSUInteger files = ++filesDeleted;
+        unsigned long long bytes = (bytesDeleted += file.size);
+        
+        if (progress) {
+            [self dispatchCompletion:^{
+                if (!isStopped() && !progress(files, bytes, NO, nil)) {
+                    @synchronized (lock) {
+                        stopped = YES;
+                    }
+                }
+            }];
+        }
+        return !isStopped();
+    };
+    
+    void (^finish)(NSError *) = ^(NSError *error) {
+        [self.metadataCache invalidatePath:path];
+        
+        // Also sent after the consumer stopped, exactly once
+        [self dispatchCompletion:^{
+            if (progress) {
+                progress(filesDeleted, bytesDeleted, YES, error);
+            }
+        }];
+    };
+    
+    SMBSharePipeline *files = [[SMBSharePipeline alloc] initWithShare:self concurrency:concurrency queue:queue operation:^NSError *(SMBFile *file, SMBSession *session, smb_tid shareID) {
+        NSString *smbPath = [file.path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+        int dsm_error = smb_file_rm(session.smbSession, shareID, smbPath.UTF8String);
+        
+        return dsm_error == 0 ? nil : [SMBError dsmError:dsm_error session:session.smbSession];
+    }];
+    SMBSharePipeline *directories = [[SMBSharePipeline alloc] initWithShare:self concurrency:concurrency queue:queue operation:^NSError *(SMBFile *directory, SMBSession *session, smb_tid shareID) {
+        NSString *smbPath = [directory.path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+        int dsm_error = smb_directory_rm(session.smbSession, shareID, smbPath.UTF8String);
+        
+        return dsm_error == 0 ? nil : [SMBError dsmError:dsm_error session:session.smbSession];
+    }];
+    
+    // Directories are removed once everything in them is gone, the deepest first
+    NSMutableArray<NSMutableArray<SMBFile *> *> *levels = [NSMutableArray array];
+    __block void (^removeLevel)(NSError *);
+    
+    files.itemCompletion = deleted;
+    directories.itemCompletion = deleted;
+    
+    removeLevel = ^(NSError *error) {
+        if (error || isStopped() || levels.count == 0) {
+            removeLevel = nil;
+            finish(error);
+        } else {
+            for (SMBFile *directory in levels.lastObject) {
+                [directories addItem:directory];
+            }
+            [levels removeLastObject];
+            [directories drain:removeLevel];
+        }
+    };
+    
+    // The listing is what is deleted, so it better be current
+    [self.metadataCache invalidatePath:path];
+    
+    [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
+        SMBFile *root = [[SMBFile alloc] initWithPath:path share:self];
+        
+        if (error == nil && !root.hasStatus) {
+            NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+            
+            root.smbStat = [self _stat:smbPath.UTF8String session:session shareID:shareID];
+        }
+        
+        dispatch_async(queue, ^{
+            if (error || !root.exists) {
+                finish(error);
+            } else if (!root.isDirectory) {
+                [files addItem:root];
+                [files drain:finish];
+            } else {
+                // The root of the share itself stays
+                [levels addObject:[root.path isEqualToString:@"/"] ? [NSMutableArray array] : [NSMutableArray arrayWithObject:root]];
+                
+                [self _walk:path concurrency:concurrency queue:queue visit:^BOOL(NSArray<SMBFile *> *entries) {
+                    NSUInteger depth = entries.firstObject.path.pathComponents.count - root.path.pathComponents.count;
+                    
+                    for (SMBFile *file in entries) {
+                        if (file.isDirectory) {
+                            if (levels.count <= depth) {
+                                [levels addObject:[NSMutableArray array]];
+                            }
+                            [levels[depth] addObject:file];
+                        } else {
+                            [files addItem:file];
+                        }
+                    }
+                    return !isStopped() && !files.cancelled;
+                } completion:^(NSError *walkError) {
+                    [files drain:^(NSError *fileError) {
+                        removeLevel(walkError ?: fileError);
+                    }];
+                }];
             }
         });
+    }];
+}
+
+- (void)downloadDirectory:(NSString *)path to:(NSString *)localPath concurrency:(NSUInteger)concurrency progress:(nullable BOOL (^)(NSUInteger, unsigned long long, BOOL, NSError *_Nullable))progress {
+    
+    dispatch_queue_t queue = dispatch_queue_create("smb_bulk_queue", DISPATCH_QUEUE_SERIAL);
+    NSFileManager *fileManager = [NSFileManager new];
+    SMBBufferPool *pool = self.server.bufferPool;
+    NSUInteger bufferSize = 1024 * 1024;
+    __block NSUInteger filesDownloaded = 0;
+    __block unsigned long long bytesDownloaded = 0;
+    __block NSError *localError = nil;
+    NSObject *lock = [NSObject new];
+    __block BOOL stopped = NO;
+    
+    BOOL (^isStopped)(void) = ^BOOL{
+        @synchronized (lock) {
+            return stopped;
+        }
+    };
+    
+    NSString *(^localPathOf)(SMBFile *) = ^NSString *(SMBFile *file) {
+        return [localPath stringByAppendingPathComponent:[file.path substringFromIndex:[path isEqualToString:@"/"] ? 0 : path.length]];
+    };
+    
+    SMBSharePipeline *files = [[SMBSharePipeline alloc] initWithShare:self concurrency:concurrency queue:queue operation:^NSError *(SMBFile *file, SMBSession *session, smb_tid shareID) {
+        NSString *smbPath = [file.path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+        NSString *cachedPath = file.smbStat ? [self.contentCache pathOfFile:file.path status:file.smbStat] : nil;
+        NSString *targetPath = localPathOf(file);
+        // Files are written under a temporary name and renamed when complete, so
+        // one that failed or was cut short doesn't show up as if it were complete
+        NSString *temporaryPath = [targetPath.stringByDeletingLastPathComponent stringByAppendingPathComponent:[NSString stringWithFormat:@".%@.download", targetPath.lastPathComponent]];
+        NSError *error = nil;
+        smb_fd fd = 0;
+        
+        [fileManager removeItemAtPath:temporaryPath error:nil];
+        
+        // The status from the listing tells whether the local copy is still current
+        if (cachedPath) {
+            if ([fileManager copyItemAtPath:cachedPath toPath:temporaryPath error:nil] && rename(temporaryPath.fileSystemRepresentation, targetPath.fileSystemRepresentation) == 0) {
+                return nil;
+            }
+            [fileManager removeItemAtPath:temporaryPath error:nil];
+        }
+        
+        uint64_t start = [self.metricsRecorder begin:SMBOperationOpen];
+        int dsm_error = smb_fopen(session.smbSession, shareID, smbPath.UTF8String, SMB_MOD_RO, &fd);
+        
+        [self.metricsRecorder end:SMBOperationOpen start:start result:dsm_error];
+        
+        if (dsm_error != 0) {
+            return [SMBError dsmError:dsm_error session:session.smbSession];
+        }
+        
+        int localFile = open(temporaryPath.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        char *buf = [pool acquireBuffer:bufferSize];
+        
+        if (localFile < 0 || buf == NULL) {
+            error = [SMBError writeError];
+        } else {
+            long bytesRead;
+            
+            while ((bytesRead = [self.metricsRecorder read:session.smbSession file:fd buffer:buf length:bufferSize]) > 0) {
+                if (write(localFile, buf, bytesRead) != bytesRead) {
+                    error = [SMBError writeError];
+                    break;
+                }
+            }
+            
+            if (bytesRead < 0) {
+                error = [SMBError readError];
+            }
+        }
+        
+        if (buf) {
+            [pool releaseBuffer:buf size:bufferSize];
+        }
+        if (localFile >= 0) {
+            close(localFile);
+        }
+        
+        uint64_t closeStart = [self.metricsRecorder begin:SMBOperationClose];
+        
+        smb_fclose(session.smbSession, fd);
+        [self.metricsRecorder end:SMBOperationClose start:closeStart result:0];
+        
+        if (error == nil && rename(temporaryPath.fileSystemRepresentation, targetPath.fileSystemRepresentation) != 0) {
+            error = [SMBError writeError];
+        }
+        
+        if (error) {
+            unlink(temporaryPath.fileSystemRepresentation);
+        } else if (file.smbStat) {
+            [self.contentCache storeFile:targetPath forFile:file.path status:file.smbStat move:NO];
+        }
+        
+        return error;
+    }];
+    
+    files.itemCompletion = ^BOOL(SMBFile *file, NSError *error) {
+        NSUInteger count = ++filesDownloaded;
+        unsigned long long bytes = (bytesDownloaded += file.size);
+        
+        if (progress) {
+            [self dispatchCompletion:^{
+                if (!isStopped() && !progress(count, bytes, NO, nil)) {
+                    @synchronized (lock) {
+                        stopped = YES;
+                    }
+                }
+            }];
+        }
+        return !isStopped();
+    };
+    
+    [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
+        SMBFile *root = [[SMBFile alloc] initWithPath:path share:self];
+        
+        if (error == nil && !root.hasStatus) {
+            NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+            
+            root.smbStat = [self _stat:smbPath.UTF8String session:session shareID:shareID];
+        }
+        
+        dispatch_async(queue, ^{
+            NSError *rootError = error;
+            
+            if (rootError == nil && !root.exists) {
+                rootError = [SMBError notSuchFileOrDirectory];
+            } else if (rootError == nil && !root.isDirectory) {
+                rootError = [SMBError notADirectoryError];
+            } else if (rootError == nil && ![fileManager createDirectoryAtPath:localPath withIntermediateDirectories:YES attributes:nil error:nil]) {
+                rootError = [SMBError writeError];
+            }
+            
+            if (rootError) {
+                [self dispatchCompletion:^{
+                    if (progress) {
+                        progress(0, 0, YES, rootError);
+                    }
+                }];
+                return;
+            }
+            
+            [self _walk:path concurrency:concurrency queue:queue visit:^BOOL(NSArray<SMBFile *> *entries) {
+                for (SMBFile *file in entries) {
+                    if (!file.isDirectory) {
+                        [files addItem:file];
+                    } else if (![fileManager createDirectoryAtPath:localPathOf(file) withIntermediateDirectories:YES attributes:nil error:nil]) {
+                        localError = [SMBError writeError];
+                        return NO;
+                    }
+                }
+                return !isStopped() && !files.cancelled;
+            } completion:^(NSError *walkError) {
+                [files drain:^(NSError *fileError) {
+                    [self dispatchCompletion:^{
+                        if (progress) {
+                            progress(filesDownloaded, bytesDownloaded, YES, localError ?: walkError ?: fileError);
+                        }
+                    }];
+                }];
+            }];
+        });
+    }];
+}
+
+- (void)uploadDirectory:(NSString *)localPath to:(NSString *)path concurrency:(NSUInteger)concurrency progress:(nullable BOOL (^)(NSUInteger, unsigned long long, BOOL, NSError *_Nullable))progress {
+    
+    dispatch_queue_t queue = dispatch_queue_create("smb_bulk_queue", DISPATCH_QUEUE_SERIAL);
+    SMBBufferPool *pool = self.server.bufferPool;
+    NSUInteger bufferSize = 1024 * 1024;
+    NSMutableArray<NSString *> *directories = [NSMutableArray arrayWithObject:@""];
+    NSMutableDictionary<NSString *, NSNumber *> *fileSizes = [NSMutableDictionary dictionary];
+    NSMutableSet<NSString *> *existingDirectories = [NSMutableSet set];
+    __block NSUInteger filesUploaded = 0;
+    __block unsigned long long bytesUploaded = 0;
+    NSObject *lock = [NSObject new];
+    __block BOOL stopped = NO;
+    
+    BOOL (^isStopped)(void) = ^BOOL{
+        @synchronized (lock) {
+            return stopped;
+        }
+    };
+    
+    NSString *(^remotePathOf)(NSString *) = ^NSString *(NSString *relativePath) {
+        return [[path stringByAppendingPathComponent:relativePath] stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+    };
+    
+    void (^finish)(NSError *) = ^(NSError *error) {
+        [self.metadataCache invalidatePath:path];
+        
+        [self dispatchCompletion:^{
+            if (progress) {
+                progress(filesUploaded, bytesUploaded, YES, error);
+            }
+        }];
+    };
+    
+    SMBSharePipeline *files = [[SMBSharePipeline alloc] initWithShare:self concurrency:concurrency queue:queue operation:^NSError *(NSString *relativePath, SMBSession *session, smb_tid shareID) {
+        const char *cpath = remotePathOf(relativePath).UTF8String;
+        NSError *error = nil;
+        smb_fd fd = 0;
+        
+        // Opening doesn't truncate, so replace files that might be there already
+        if ([existingDirectories containsObject:relativePath.stringByDeletingLastPathComponent]) {
+            smb_file_rm(session.smbSession, shareID, cpath);
+        }
+        
+        uint64_t start = [self.metricsRecorder begin:SMBOperationOpen];
+        int dsm_error = smb_fopen(session.smbSession, shareID, cpath, SMB_MOD_RW, &fd);
+        
+        [self.metricsRecorder end:SMBOperationOpen start:start result:dsm_error];
+        
+        if (dsm_error != 0) {
+            return [SMBError dsmError:dsm_error session:session.smbSession];
+        }
+        
+        int localFile = open([localPath stringByAppendingPathComponent:relativePath].fileSystemRepresentation, O_RDONLY);
+        char *buf = [pool acquireBuffer:bufferSize];
+        
+        if (localFile < 0 || buf == NULL) {
+            error = [SMBError readError];
+        } else {
+            ssize_t bytesRead = 0;
+            
+            while (error == nil && (bytesRead = read(localFile, buf, bufferSize)) > 0) {
+                ssize_t bytesWritten = 0;
+                
+                while (bytesWritten < bytesRead) {
+                    ssize_t result = [self.metricsRecorder write:session.smbSession file:fd buffer:buf + bytesWritten length:bytesRead - bytesWritten];
+                    
+                    if (result <= 0) {
+                        error = [SMBError writeError];
+                        break;
+                    }
+                    bytesWritten += result;
+                }
+            }
+            
+            if (error == nil && bytesRead < 0) {
+                error = [SMBError readError];
+            }
+        }
+        
+        if (buf) {
+            [pool releaseBuffer:buf size:bufferSize];
+        }
+        if (localFile >= 0) {
+            close(localFile);
+        }
+        
+        uint64_t closeStart = [self.metricsRecorder begin:SMBOperationClose];
+        
+        smb_fclose(session.smbSession, fd);
+        [self.metricsRecorder end:SMBOperationClose start:closeStart result:0];
+        
+        return error;
+    }];
+    
+    files.itemCompletion = ^BOOL(NSString *relativePath, NSError *error) {
+        NSUInteger count = ++filesUploaded;
+        unsigned long long bytes = (bytesUploaded += fileSizes[relativePath].unsignedLongLongValue);
+        
+        if (progress) {
+            [self dispatchCompletion:^{
+                if (!isStopped() && !progress(count, bytes, NO, nil)) {
+                    @synchronized (lock) {
+                        stopped = YES;
+                    }
+                }
+            }];
+        }
+        return !isStopped();
+    };
+    
+    dispatch_async(queue, ^{
+        NSDirectoryEnumerator<NSString *> *enumerator = [[NSFileManager new] enumeratorAtPath:localPath];
+        NSMutableArray<NSString *> *relativeFilePaths = [NSMutableArray array];
+        
+        if (enumerator == nil) {
+            finish([SMBError notSuchFileOrDirectory]);
+            return;
+        }
+        
+        for (NSString *relativePath in enumerator) {
+            NSDictionary<NSFileAttributeKey, id> *attributes = enumerator.fileAttributes;
+            
+            if ([attributes.fileType isEqualToString:NSFileTypeDirectory]) {
+                [directories addObject:relativePath];
+            } else if ([attributes.fileType isEqualToString:NSFileTypeRegular]) {
+                fileSizes[relativePath] = @(attributes.fileSize);
+                [relativeFilePaths addObject:relativePath];
+            }
+        }
+        
+        // Parents are enumerated before their contents, so the directories are created in order
+        [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
+            NSMutableSet<NSString *> *existing = [NSMutableSet set];
+            
+            for (NSString *relativePath in directories) {
+                if (error) {
+                    break;
+                }
+                
+                // The root of the share is always there
+                if ([remotePathOf(relativePath) isEqualToString:@"\\"]) {
+                    [existing addObject:relativePath];
+                    continue;
+                }
+                
+                int dsm_error = smb_directory_create(session.smbSession, shareID, remotePathOf(relativePath).UTF8String);
+                
+                if ([self _isNTStatus:NT_STATUS_OBJECT_NAME_COLLISION error:dsm_error session:session]) {
+                    [existing addObject:relativePath];
+                } else if (dsm_error != 0) {
+                    error = [SMBError dsmError:dsm_error session:session.smbSession];
+                }
+            }
+            
+            dispatch_async(queue, ^{
+                if (error) {
+                    finish(error);
+                } else {
+                    [existingDirectories unionSet:existing];
+                    
+                    for (NSString *relativePath in relativeFilePaths) {
+                        [files addItem:relativePath];
+                    }
+                    [files drain:finish];
+                }
+            });
+        }];
+    });
+}
+
+- (void)resumableDownload:(NSString *)path to:(NSString *)localPath progress:(nullable BOOL (^)(unsigned long long, BOOL, NSError *_Nullable))progress {
+    [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
+        NSString *key = [NSString stringWithFormat:@"download\n%@\n%@\n%@\n%@", self.server.host, self.name, path.lowercaseString, localPath];
+        SMBTransferRecord *record = [[SMBTransferRecord alloc] initWithKey:key];
+        unsigned long long bytesTotal = 0;
+        int localFile = -1;
+        smb_fd fd = 0;
+        
+        if (error == nil) {
+            NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+            uint64_t start = [self.metricsRecorder begin:SMBOperationOpen];
+            int dsm_error = smb_fopen(session.smbSession, shareID, smbPath.UTF8String, SMB_MOD_RO, &fd);
+            
+            [self.metricsRecorder end:SMBOperationOpen start:start result:dsm_error];
+            
+            if (dsm_error != 0) {
+                error = [SMBError dsmError:dsm_error session:session.smbSession];
+            }
+        }
+        
+        if (error == nil) {
+            SMBStat *stat = [SMBStat statWithStat:smb_stat_fd(session.smbSession, fd)];
+            NSDictionary *source = @{@"size": @(stat.size), @"writeTime": @(stat.writeTimestamp), @"modificationTime": @(stat.modificationTimestamp)};
+            struct stat localStat;
+            
+            localFile = open(localPath.fileSystemRepresentation, O_WRONLY | O_CREAT, 0644);
+            
+            if (localFile < 0 || fstat(localFile, &localStat) != 0) {
+                error = [SMBError writeError];
+            } else {
+                bytesTotal = [record offsetForSource:source target:nil limit:localStat.st_size];
+                
+                // Anything after the recorded offset may not have been written completely
+                if (ftruncate(localFile, bytesTotal) != 0 || lseek(localFile, bytesTotal, SEEK_SET) < 0) {
+                    error = [SMBError writeError];
+                } else if (smb_fseek(session.smbSession, fd, bytesTotal, SMB_SEEK_SET) < 0) {
+                    error = [SMBError seekError];
+                } else {
+                    error = [self _transfer:^long(char *buf, NSUInteger length) {
+                        return [self.metricsRecorder read:session.smbSession file:fd buffer:buf length:length];
+                    } to:^BOOL(const char *buf, long length) {
+                        return write(localFile, buf, length) == length;
+                    } flush:^BOOL{
+                        return fsync(localFile) == 0;
+                    } bytesTotal:&bytesTotal record:record source:source target:nil progress:progress];
+                }
+            }
+        }
+        
+        if (localFile >= 0) {
+            close(localFile);
+        }
+        if (fd) {
+            uint64_t closeStart = [self.metricsRecorder begin:SMBOperationClose];
+            
+            smb_fclose(session.smbSession, fd);
+            [self.metricsRecorder end:SMBOperationClose start:closeStart result:0];
+        }
+        
+        if (progress) {
+            [self dispatchCompletion:^{
+                progress(bytesTotal, YES, error);
+            }];
+        }
+    }];
+}
+
+- (void)resumableUpload:(NSString *)localPath to:(NSString *)path progress:(nullable BOOL (^)(unsigned long long, BOOL, NSError *_Nullable))progress {
+    [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
+        NSString *key = [NSString stringWithFormat:@"upload\n%@\n%@\n%@\n%@", self.server.host, self.name, path.lowercaseString, localPath];
+        SMBTransferRecord *record = [[SMBTransferRecord alloc] initWithKey:key];
+        NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:localPath error:nil];
+        unsigned long long bytesTotal = 0;
+        int localFile = -1;
+        smb_fd fd = 0;
+        
+        if (error == nil) {
+            localFile = open(localPath.fileSystemRepresentation, O_RDONLY);
+            
+            if (localFile < 0 || attributes == nil) {
+                error = [SMBError readError];
+            }
+        }
+        
+        if (error == nil) {
+            NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+            const char *cpath = smbPath.UTF8String;
+            NSDictionary *source = @{@"size": @(attributes.fileSize), @"modificationTime": @(attributes.fileModificationDate.timeIntervalSinceReferenceDate)};
+            SMBStat *stat = [self _stat:cpath session:session shareID:shareID];
+            int dsm_error = 0;
+            
+            // The remote file must not have changed since the offset was recorded
+            NSDictionary *(^stateOf)(SMBStat *) = ^NSDictionary *(SMBStat *targetStat) {
+                return @{@"size": @(targetStat.size), @"writeTime": @(targetStat.writeTimestamp), @"modificationTime": @(targetStat.modificationTimestamp)};
+            };
+            NSDictionary *(^target)(void) = ^NSDictionary *{
+                return stateOf([self _stat:cpath session:session shareID:shareID]);
+            };
+            
+            bytesTotal = [record offsetForSource:source target:stat.exists ? stateOf(stat) : nil limit:stat.exists ? stat.size : 0];
+            
+            // A file can't be truncated, so starting over means starting with a new one
+            if (bytesTotal == 0 && stat.exists) {
+                dsm_error = smb_file_rm(session.smbSession, shareID, cpath);
+            }
+            
+            if (dsm_error == 0) {
+                uint64_t start = [self.metricsRecorder begin:SMBOperationOpen];
+                
+                dsm_error = smb_fopen(session.smbSession, shareID, cpath, SMB_MOD_RW, &fd);
+                [self.metricsRecorder end:SMBOperationOpen start:start result:dsm_error];
+            }
+            
+            if (dsm_error != 0) {
+                error = [SMBError dsmError:dsm_error session:session.smbSession];
+            } else if (lseek(localFile, bytesTotal, SEEK_SET) < 0 || smb_fseek(session.smbSession, fd, bytesTotal, SMB_SEEK_SET) < 0) {
+                error = [SMBError seekError];
+            } else {
+                error = [self _transfer:^long(char *buf, NSUInteger length) {
+                    return read(localFile, buf, length);
+                } to:^BOOL(const char *buf, long length) {
+                    long bytesWritten = 0;
+                    
+                    // A single write may accept less than requested
+                    while (bytesWritten < length) {
+                        long result = [self.metricsRecorder write:session.smbSession file:fd buffer:(char *)buf + bytesWritten length:length - bytesWritten];
+                        
+                        if (result <= 0) {
+                            return NO;
+                        }
+                        bytesWritten += result;
+                    }
+                    return YES;
+                } flush:nil bytesTotal:&bytesTotal record:record source:source target:target progress:progress];
+            }
+            
+            if (fd) {
+                uint64_t closeStart = [self.metricsRecorder begin:SMBOperationClose];
+                
+                smb_fclose(session.smbSession, fd);
+                [self.metricsRecorder end:SMBOperationClose start:closeStart result:0];
+                fd = 0;
+                
+                // The server may only update the times of the file once it's closed
+                [record setTarget:target()];
+            }
+            
+            [self.metadataCache invalidatePath:path];
+        }
+        
+        if (localFile >= 0) {
+            close(localFile);
+        }
+        
+        if (progress) {
+            [self dispatchCompletion:^{
+                progress(bytesTotal, YES, error);
+            }];
+        }
+    }];
+}
+
+- (void)moveFile:(NSString *)oldPath to:(NSString *)newPath completion:(void (^)(SMBFile *, NSError *))completion {
+    [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
+        SMBFile *file = nil;
+        
+        if (error == nil) {
+            NSString *smbOldPath = [oldPath stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+            NSString *smbNewPath = [newPath stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+
+            int res = smb_file_mv(session.smbSession, shareID, smbOldPath.UTF8String, smbNewPath.UTF8String);
+            
+            [self.metadataCache invalidatePath:oldPath];
+            [self.metadataCache invalidatePath:newPath];
+            
+            if (res != 0) {
+                error = [SMBError notSuchFileOrDirectory];
+            } else {
+                NSUInteger generation = self.metadataCache.generation;
+                
+                file = [SMBFile fileWithPath:newPath share:self];
+                file.smbStat = [self _stat:smbNewPath.UTF8String session:session shareID:shareID];
+                [self.metadataCache setStat:file.smbStat forPath:newPath generation:generation];
+            }
+        }
+        
+        if (completion) {
+            [self dispatchCompletion:^{
+                completion(file, error);
+            }];
+        }
+    }];
+}
+
+- (void)getStatusOfFile:(NSString *)path completion:(void (^)(SMBStat *, NSError *))completion {
+
+    SMBStat *cachedStat = nil;
+    
+    if (path.length == 0 || [path isEqualToString:@"/"]) {
+        if (completion) {
+            [self dispatchCompletion:^{
+                completion([SMBStat statForRoot], nil);
+            }];
+        }
+    } else if (self.isOpen && (cachedStat = [self.metadataCache statForPath:path])) {
+        if (completion) {
+            [self dispatchCompletion:^{
+                completion(cachedStat, nil);
+            }];
+        }
+    } else {
+        [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
+            SMBStat *smbStat = nil;
+            
+            if (error == nil) {
+                NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+                NSUInteger generation = self.metadataCache.generation;
+                
+                smbStat = [self _stat:smbPath.UTF8String session:session shareID:shareID];
+                [self.metadataCache setStat:smbStat forPath:path generation:generation];
+            }
+            
+            if (completion) {
+                [self dispatchCompletion:^{
+                    completion(smbStat, error);
+                }];
+            }
+        }];
     }    
 }
 
 #pragma mark - Private methods
 
-- (SMBStat *)_stat:(const char *)path {
-    smb_stat stat = smb_fstat(self.server.smbSession, _shareID, path);
-    SMBStat *smbStat = [SMBStat statForNonExistingFile];
+// Each share has a directory of its own in the caches of the app, per account, as
+// users needn't be allowed to read the same files
+- (NSString *)_contentCacheDirectory {
+    NSString *caches = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject ?: NSTemporaryDirectory();
+    NSString *share = [NSString stringWithFormat:@"%@_%@_%@", self.server.host, self.name, self.server.account ?: @""].lowercaseString;
     
-    // This is a workaround because the above doesn't seem to work on directories
-    // See https://github.com/videolabs/libdsm/issues/79
+    share = [share stringByReplacingOccurrencesOfString:@"/" withString:@"_"];
+    share = [share stringByReplacingOccurrencesOfString:@"\\" withString:@"_"];
     
-    if (stat == NULL) {
-        smb_stat_list statList = smb_find(self.server.smbSession, _shareID, path);
+    return [[caches stringByAppendingPathComponent:@"SMBClient"] stringByAppendingPathComponent:share];
+}
+
+- (NSString *)_searchPattern:(NSString *)path {
+    NSString *smbPath = [path stringByReplacingOccurrencesOfString:@"/" withString:@"\\"];
+    
+    if (![smbPath hasSuffix:@"\\"]) {
+        smbPath = [smbPath stringByAppendingString:@"\\"];
+    }
+    return [smbPath stringByAppendingString:@"*"];
+}
+
+- (BOOL)_isNTStatus:(uint32_t)status error:(int)dsmError session:(SMBSession *)session {
+    return dsmError == DSM_ERROR_NT && smb_session_get_nt_status(session.smbSession) == status;
+}
+
+// The SMB paths of all directories leading to path, e.g. \a and \a\b for a/b
+- (NSArray<NSString *> *)_smbPathsOfDirectories:(NSString *)path {
+    NSMutableArray<NSString *> *directories = [NSMutableArray array];
+    NSString *p = @"";
+    
+    for (NSString *component in path.pathComponents) {
+        if (![component isEqualToString:@"/"]) {
+            p = [p stringByAppendingFormat:@"\\%@", component];
+            [directories addObject:p];
+        }
+    }
+    
+    return directories;
+}
+
+// Creates the last of the directories, assuming that it usually is the only one
+// missing. Its parents are only created when the server says they're missing.
+// Lowercased paths in `existing` are known to exist and are added to.
+- (NSError *)_createDirectories:(NSArray<NSString *> *)directories existing:(NSMutableSet<NSString *> *)existing session:(SMBSession *)session shareID:(smb_tid)shareID {
+    NSInteger i = (NSInteger)directories.count - 1;
+    
+    // Walk up until creating succeeds or the directory is there
+    while (i >= 0 && ![existing containsObject:directories[i].lowercaseString]) {
+        int dsm_error = smb_directory_create(session.smbSession, shareID, directories[i].UTF8String);
+        
+        if (dsm_error == 0) {
+            [self.metadataCache invalidatePath:directories[i]];
+        }
+        
+        if (dsm_error == 0 || [self _isNTStatus:NT_STATUS_OBJECT_NAME_COLLISION error:dsm_error session:session]) {
+            [existing addObject:directories[i].lowercaseString];
+            break;
+        }
+        
+        if (![self _isNTStatus:NT_STATUS_OBJECT_PATH_NOT_FOUND error:dsm_error session:session] &&
+            ![self _isNTStatus:NT_STATUS_OBJECT_NAME_NOT_FOUND error:dsm_error session:session]) {
+            return [SMBError dsmError:dsm_error session:session.smbSession];
+        }
+        i--;
+    }
+    
+    // Then back down
+    for (NSUInteger j = (NSUInteger)(i + 1); j < directories.count; j++) {
+        int dsm_error = smb_directory_create(session.smbSession, shareID, directories[j].UTF8String);
+        
+        if (dsm_error == 0) {
+            [self.metadataCache invalidatePath:directories[j]];
+        } else if (![self _isNTStatus:NT_STATUS_OBJECT_NAME_COLLISION error:dsm_error session:session]) {
+            return [SMBError dsmError:dsm_error session:session.smbSession];
+        }
+        [existing addObject:directories[j].lowercaseString];
+    }
+    
+    return nil;
+}
+
+- (SMBFile *)_createdDirectory:(NSString *)path session:(SMBSession *)session shareID:(smb_tid)shareID {
+    SMBFile *file = [[SMBFile alloc] initWithPath:path share:self];
+    
+    if (!self.lazyStatus) {
+        NSString *smbPath = [self _smbPathsOfDirectories:path].lastObject;
+        NSUInteger generation = self.metadataCache.generation;
+        
+        file.smbStat = [self _findStat:smbPath.UTF8String session:session shareID:shareID];
+        [self.metadataCache setStat:file.smbStat forPath:path generation:generation];
+    }
+    
+    return file;
+}
+
+// Searches the directories of a tree breadth first, up to `concurrency` of them at
+// a time. `visit` gets the entries of each directory and returns NO to stop the
+// walk. Both blocks are called on the queue, completion exactly once. A directory
+// that can't be searched is skipped, and its error passed to completion in the end.
+- (void)_walk:(NSString *)path concurrency:(NSUInteger)concurrency queue:(dispatch_queue_t)queue visit:(BOOL (^)(NSArray<SMBFile *> *files))visit completion:(void (^)(NSError *error))completion {
+    NSUInteger maxConcurrency = MAX(concurrency, 1);
+    NSMutableArray<NSString *> *directories = [NSMutableArray arrayWithObject:path];
+    __block NSUInteger running = 0;
+    __block NSError *searchError = nil;
+    NSObject *lock = [NSObject new];
+    __block BOOL finished = NO;
+    __block void (^schedule)(void);
+    
+    BOOL (^isFinished)(void) = ^BOOL{
+        @synchronized (lock) {
+            return finished;
+        }
+    };
+    
+    void (^finish)(NSError *) = ^(NSError *error) {
+        @synchronized (lock) {
+            finished = YES;
+        }
+        schedule = nil;
+        completion(error);
+    };
+    
+    schedule = ^{
+        while (!finished && running < maxConcurrency && directories.count > 0) {
+            NSString *directory = directories.firstObject;
+            
+            [directories removeObjectAtIndex:0];
+            running++;
+            
+            [self _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
+                NSArray<SMBStat *> *listing = nil;
+                NSError *listingError = nil;
+                
+                if (error == nil && !isFinished()) {
+                    listing = [self _listing:directory session:session shareID:shareID error:&listingError];
+                }
+                
+                dispatch_async(queue, ^{
+                    running--;
+                    
+                    if (finished) {
+                        return;
+                    }
+                    
+                    if (error) {
+                        finish(error);
+                        return;
+                    }
+                    
+                    if (searchError == nil) {
+                        searchError = listingError;
+                    }
+                    
+                    NSArray<SMBFile *> *files = [self _files:listing inDirectory:directory filter:nil];
+                    
+                    for (SMBFile *file in files) {
+                        if (file.isDirectory) {
+                            [directories addObject:file.path];
+                        }
+                    }
+                    
+                    if (files.count > 0 && !visit(files)) {
+                        finish(nil);
+                    } else if (running == 0 && directories.count == 0) {
+                        finish(searchError);
+                    } else {
+                        schedule();
+                    }
+                });
+            }];
+        }
+    };
+    
+    dispatch_async(queue, ^{
+        schedule();
+    });
+}
+
+// Searches the directory, unless its listing is cached. Returns nil and sets error if
+// the search failed.
+- (NSArray<SMBStat *> *)_listing:(NSString *)path session:(SMBSession *)session shareID:(smb_tid)shareID error:(NSError **)error {
+    NSArray<SMBStat *> *listing = [self.metadataCache listingForPath:path];
+    
+    if (listing == nil) {
+        NSUInteger generation = self.metadataCache.generation;
+        uint64_t start = [self.metricsRecorder begin:SMBOperationFind];
+        smb_stat_list statList = smb_find(session.smbSession, shareID, [self _searchPattern:path].UTF8String);
+        
+        [self.metricsRecorder end:SMBOperationFind start:start result:statList ? 0 : -1];
         
         if (statList != NULL) {
             size_t listCount = smb_stat_list_count(statList);
+            NSMutableArray<SMBStat *> *entries = [NSMutableArray arrayWithCapacity:listCount];
             
-            if (listCount == 1) {
-                stat = smb_stat_list_at(statList, 0);
-                smbStat = [SMBStat statWithStat:stat];
-            } else {
-                NSLog(@"Unexpectedly got multiple stat entries for %s", path);
+            for (NSUInteger i = 0; i < listCount; i++) {
+                SMBStat *stat = [self _entryOfList:statList at:i];
+                
+                if (stat) {
+                    [entries addObject:stat];
+                }
             }
-            
             smb_stat_list_destroy(statList);
+            
+            [self.metadataCache setListing:entries forPath:path generation:generation];
+            listing = entries;
+        } else if (error) {
+            BOOL ntError = smb_session_get_nt_status(session.smbSession) != NT_STATUS_SUCCESS;
+            
+            *error = ntError ? [SMBError dsmError:DSM_ERROR_NT session:session.smbSession] : [SMBError notSuchFileOrDirectory];
+        }
+    }
+    
+    return listing;
+}
+
+// Returns nil for '.' and '..'
+- (SMBStat *)_entryOfList:(smb_stat_list)statList at:(NSUInteger)index {
+    SMBStat *stat = [[SMBStat alloc] initWithStat:smb_stat_list_at(statList, index)];
+    
+    if (stat.isDirectory && ([stat.smbName isEqualToString:@".."] || [stat.smbName isEqualToString:@"."])) {
+        return nil;
+    }
+    return stat;
+}
+
+// Hands the entries to progress in batches on the completion queue, while at most
+// SMBMaximumPendingBatches are waiting there. Returns NO if progress stopped it,
+// which still gets a last call with complete set.
+- (BOOL)_enumerate:(NSUInteger)count entries:(SMBStat *(^)(NSUInteger index))entryAtIndex inDirectory:(NSString *)path batchSize:(NSUInteger)batchSize filter:(BOOL (^)(SMBFile *file))filter progress:(BOOL (^)(NSArray<SMBFile *> *files, BOOL complete, NSError *error))progress {
+    
+    dispatch_semaphore_t pending = dispatch_semaphore_create(0);
+    NSObject *lock = [NSObject new];
+    __block BOOL finished = NO;
+    
+    BOOL (^isFinished)(void) = ^BOOL{
+        @synchronized (lock) {
+            return finished;
+        }
+    };
+    
+    for (NSUInteger i = 0; i < SMBMaximumPendingBatches; i++) {
+        dispatch_semaphore_signal(pending);
+    }
+    
+    BOOL (^deliver)(NSArray<SMBFile *> *, BOOL) = ^BOOL(NSArray<SMBFile *> *files, BOOL complete) {
+        dispatch_semaphore_wait(pending, DISPATCH_TIME_FOREVER);
+        
+        if (isFinished()) {
+            dispatch_semaphore_signal(pending);
+            return NO;
+        }
+        
+        [self dispatchCompletion:^{
+            if (!isFinished()) {
+                if (progress == nil || !progress(files, complete, nil)) {
+                    @synchronized (lock) {
+                        finished = YES;
+                    }
+                }
+            } else if (complete && progress) {
+                // An earlier batch stopped it after this one was on its way
+                progress(nil, YES, nil);
+            }
+            dispatch_semaphore_signal(pending);
+        }];
+        return YES;
+    };
+    
+    NSUInteger size = MAX(batchSize, 1);
+    NSMutableArray<SMBFile *> *batch = [NSMutableArray arrayWithCapacity:size];
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        SMBStat *stat = entryAtIndex(i);
+        
+        if (stat) {
+            SMBFile *file = [[SMBFile alloc] initWithPath:[path stringByAppendingPathComponent:stat.smbName] share:self];
+            
+            file.smbStat = stat;
+            
+            if (filter == nil || filter(file)) {
+                [batch addObject:file];
+            }
+        }
+        
+        if (batch.count == size) {
+            if (!deliver([batch copy], NO)) {
+                break;
+            }
+            [batch removeAllObjects];
+        }
+    }
+    
+    if (deliver([batch copy], YES)) {
+        return YES;
+    }
+    
+    if (progress) {
+        [self dispatchCompletion:^{
+            progress(nil, YES, nil);
+        }];
+    }
+    return NO;
+}
+
+- (NSArray<SMBFile *> *)_files:(NSArray<SMBStat *> *)listing inDirectory:(NSString *)path filter:(BOOL (^)(SMBFile *file))filter {
+    NSMutableArray<SMBFile *> *fileList = [NSMutableArray arrayWithCapacity:listing.count];
+    
+    for (SMBStat *stat in listing) {
+        SMBFile *file = [[SMBFile alloc] initWithPath:[path stringByAppendingPathComponent:stat.smbName] share:self];
+        
+        file.smbStat = stat;
+        
+        if (filter == nil || filter(file)) {
+            [fileList addObject:file];
+        }
+    }
+    
+    return fileList;
+}
+
+// Copies chunks from the reader to the writer, starting at bytesTotal, until the
+// reader is exhausted or progress returns NO. Every SMBTransferRecordInterval bytes,
+// and when the transfer stops early, the offset reached is recorded once flush has
+// made sure the data is stored, along with the state of the target if given. A
+// completed transfer removes the record.
+- (NSError *)_transfer:(long (^)(char *buf, NSUInteger length))reader to:(BOOL (^)(const char *buf, long length))writer flush:(BOOL (^)(void))flush bytesTotal:(unsigned long long *)bytesTotal record:(SMBTransferRecord *)record source:(NSDictionary *)source target:(NSDictionary *(^)(void))target progress:(BOOL (^)(unsigned long long, BOOL, NSError *))progress {
+    SMBBufferPool *pool = self.server.bufferPool;
+    NSUInteger bufferSize = 1024 * 1024;
+    char *buf = [pool acquireBuffer:bufferSize];
+    unsigned long long recorded = *bytesTotal;
+    NSObject *lock = [NSObject new];
+    __block BOOL stopped = NO;
+    NSError *error = nil;
+    
+    BOOL (^isStopped)(void) = ^BOOL{
+        @synchronized (lock) {
+            return stopped;
         }
+    };
+    
+    if (buf == NULL) {
+        return [SMBError unknownError];
+    }
+    
+    if (progress) {
+        unsigned long long total = *bytesTotal;
+        
+        [self dispatchCompletion:^{
+            if (!progress(total, NO, nil)) {
+                @synchronized (lock) {
+                    stopped = YES;
+                }
+            }
+        }];
+    }
+    
+    while (!isStopped()) {
+        long bytesRead = reader(buf, bufferSize);
+        
+        if (bytesRead < 0) {
+            error = [SMBError readError];
+            break;
+        } else if (bytesRead == 0) {
+            break;
+        } else if (!writer(buf, bytesRead)) {
+            error = [SMBError writeError];
+            break;
+        }
+        
+        *bytesTotal += bytesRead;
+        
+        if (*bytesTotal - recorded >= SMBTransferRecordInterval && (flush == nil || flush())) {
+            recorded = *bytesTotal;
+            [record setOffset:recorded source:source target:target ? target() : nil];
+        }
+        
+        if (progress) {
+            unsigned long long total = *bytesTotal;
+            
+            [self dispatchCompletion:^{
+                if (!isStopped() && !progress(total, NO, nil)) {
+                    @synchronized (lock) {
+                        stopped = YES;
+                    }
+                }
+            }];
+        }
+    }
+    
+    [pool releaseBuffer:buf size:bufferSize];
+    
+    if (error == nil && !isStopped()) {
+        [record remove];
+    } else if (*bytesTotal > recorded && (flush == nil || flush())) {
+        [record setOffset:*bytesTotal source:source target:target ? target() : nil];
+    }
+    
+    return error;
+}
+
+// Runs the block on the given session, or on any session of the pool if nil,
+// after making sure the share is connected on it
+- (void)_performOnSession:(SMBSession *)session block:(void (^)(SMBSession *session, smb_tid shareID, NSError *error))block {
+    uint64_t enqueued = [SMBMetricsRecorder now];
+    
+    void (^task)(SMBSession *) = ^(SMBSession *s) {
+        NSError *error = nil;
+        smb_tid shareID = 0;
+        
+        [self.metricsRecorder waitedSince:enqueued];
+        
+        if (s.smbSession == NULL) {
+            error = [SMBError notConnectedError];
+        } else if (![self isOpen]) {
+            error = [SMBError notOpenError];
+        } else {
+            shareID = [s shareIDForShare:self.name error:&error];
+        }
+        
+        block(s, shareID, error);
+    };
+    
+    if (session) {
+        [session perform:task];
+    } else {
+        [self.server performOnSession:task];
+    }
+}
+
+- (SMBStat *)_stat:(const char *)path session:(SMBSession *)session shareID:(smb_tid)shareID {
+    uint64_t start = [self.metricsRecorder begin:SMBOperationStat];
+    smb_stat stat = smb_fstat(session.smbSession, shareID, path);
+    SMBStat *smbStat = nil;
+    
+    [self.metricsRecorder end:SMBOperationStat start:start result:stat ? 0 : -1];
+    
+    // This is a workaround because the above doesn't seem to work on directories
+    // See https://github.com/videolabs/libdsm/issues/79
+    
+    if (stat == NULL) {
+        smbStat = [self _findStat:path session:session shareID:shareID];
     } else {
         smbStat = [SMBStat statWithStat:stat];
         smb_stat_destroy(stat);
@@ -484,9 +1827,40 @@
     return smbStat;
 }
 
+// Gets the status by a search, which also works for directories
+- (SMBStat *)_findStat:(const char *)path session:(SMBSession *)session shareID:(smb_tid)shareID {
+    SMBStat *smbStat = [SMBStat statForNonExistingFile];
+    uint64_t start = [self.metricsRecorder begin:SMBOperationStat];
+    smb_stat_list statList = smb_find(session.smbSession, shareID, path);
+    
+    [self.metricsRecorder end:SMBOperationStat start:start result:statList ? 0 : -1];
+    
+    if (statList != NULL) {
+        size_t listCount = smb_stat_list_count(statList);
+        
+        if (listCount == 1) {
+            smbStat = [SMBStat statWithStat:smb_stat_list_at(statList, 0)];
+        } else {
+            NSLog(@"Unexpectedly got multiple stat entries for %s", path);
+        }
+        
+        smb_stat_list_destroy(statList);
+    }
+    
+    return smbStat;
+}
+
 @end
 
-@implementation SMBStat
+// Listings produce lots of these, so the raw values are kept and dates are
+// only created when they're asked for
+@implementation SMBStat {
+    uint64_t _creationTimestamp;
+    uint64_t _modificationTimestamp;
+    uint64_t _accessTimestamp;
+    uint64_t _writeTimestamp;
+    NSTimeInterval _statTimestamp;
+}
 
 + (nullable instancetype)statForNonExistingFile {
     return [[self alloc] initForNonExistingFile];
@@ -503,7 +1877,7 @@
 - (nullable instancetype)initForNonExistingFile {
     self = [super init];
     if (self) {
-        _statTime = [NSDate new];
+        _statTimestamp = [NSDate timeIntervalSinceReferenceDate];
     }
     return self;
 }
@@ -513,7 +1887,7 @@
     if (self) {
         _directory = YES;
         _exists = YES;
-        _statTime = [NSDate new];
+        _statTimestamp = [NSDate timeIntervalSinceReferenceDate];
         _smbName = @"\\";
     }
     return self;
@@ -523,25 +1897,20 @@
     self = [super init];
     if (self) {
         if (stat != NULL) {
-            uint64_t modificationTimestamp = smb_stat_get(stat, SMB_STAT_MTIME);
-            uint64_t creationTimestamp = smb_stat_get(stat, SMB_STAT_CTIME);
-            uint64_t accessTimestamp = smb_stat_get(stat, SMB_STAT_ATIME);
-            uint64_t writeTimestamp = smb_stat_get(stat, SMB_STAT_WTIME);
+            _modificationTimestamp = smb_stat_get(stat, SMB_STAT_MTIME);
+            _creationTimestamp = smb_stat_get(stat, SMB_STAT_CTIME);
+            _accessTimestamp = smb_stat_get(stat, SMB_STAT_ATIME);
+            _writeTimestamp = smb_stat_get(stat, SMB_STAT_WTIME);
             
             _smbName = [NSString stringWithUTF8String:smb_stat_name(stat)];
             
             _size = smb_stat_get(stat, SMB_STAT_SIZE);
             _directory = (smb_stat_get(stat, SMB_STAT_ISDIR) != 0);
             
-            _modificationTime = [self _dateFromSMBTime:modificationTimestamp];
-            _creationTime = [self _dateFromSMBTime:creationTimestamp];
-            _accessTime = [self _dateFromSMBTime:accessTimestamp];
-            _writeTime = [self _dateFromSMBTime:writeTimestamp];
-            
             _exists = YES;
         }
         
-        _statTime = [NSDate new];
+        _statTimestamp = [NSDate timeIntervalSinceReferenceDate];
     }
     return self;
 }
@@ -550,9 +1919,33 @@
     return [NSString stringWithFormat:@"Status of %@ %@ as of %@: Size: %llu, Created: %@, Modified: %@, Last opened: %@", self.isDirectory ? @"directory" : @"file", self.smbName, self.statTime, self.size, self.creationTime, self.modificationTime, self.accessTime];
 }
 
+- (NSDate *)creationTime {
+    return [self _dateFromSMBTime:_creationTimestamp];
+}
+
+- (NSDate *)modificationTime {
+    return [self _dateFromSMBTime:_modificationTimestamp];
+}
+
+- (NSDate *)accessTime {
+    return [self _dateFromSMBTime:_accessTimestamp];
+}
+
+- (NSDate *)writeTime {
+    return [self _dateFromSMBTime:_writeTimestamp];
+}
+
+- (NSDate *)statTime {
+    return [NSDate dateWithTimeIntervalSinceReferenceDate:_statTimestamp];
+}
+
 #pragma mark - Private methods
 
 - (NSDate *)_dateFromSMBTime:(uint64_t)smbTime {
+    if (smbTime == 0) {
+        return nil;
+    }
+    
     // If you really want some explanation, search for
     // 'SystemTimeLow and SystemTimeHigh' at http://ubiqx.org/cifs/SMB.html
     
@@ -562,3 +1955,82 @@
 }
 
 @end
+
+@implementation SMBSharePipeline {
+    SMBShare *_share;
+    NSUInteger _concurrency;
+    dispatch_queue_t _queue;
+    NSError *(^_operation)(id, SMBSession *, smb_tid);
+    NSMutableArray *_items;
+    NSUInteger _running;
+    NSError *_error;
+    void (^_drained)(NSError *);
+}
+
+- (instancetype)initWithShare:(SMBShare *)share concurrency:(NSUInteger)concurrency queue:(dispatch_queue_t)queue operation:(NSError *(^)(id, SMBSession *, smb_tid))operation {
+    self = [super init];
+    if (self) {
+        _share = share;
+        _concurrency = MAX(concurrency, 1);
+        _queue = queue;
+        _operation = [operation copy];
+        _items = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (void)addItem:(id)item {
+    [_items addObject:item];
+    [self _schedule];
+}
+
+- (void)drain:(void (^)(NSError *))completion {
+    _drained = [completion copy];
+    [self _checkDrained];
+}
+
+#pragma mark - Private methods
+
+- (void)_schedule {
+    while (!_cancelled && _running < _concurrency && _items.count > 0) {
+        id item = _items.firstObject;
+        
+        [_items removeObjectAtIndex:0];
+        _running++;
+        
+        [_share _performOnSession:nil block:^(SMBSession *session, smb_tid shareID, NSError *error) {
+            if (error == nil && !self->_cancelled) {
+                error = self->_operation(item, session, shareID);
+            }
+            
+            dispatch_async(self->_queue, ^{
+                self->_running--;
+                
+                if (!self->_cancelled) {
+                    if (error) {
+                        self->_error = error;
+                        self->_cancelled = YES;
+                    } else if (self.itemCompletion && !self.itemCompletion(item, nil)) {
+                        self->_cancelled = YES;
+                    }
+                }
+                
+                [self _schedule];
+                [self _checkDrained];
+            });
+        }];
+    }
+}
+
+- (void)_checkDrained {
+    if (_drained && _running == 0 && (_cancelled || _items.count == 0)) {
+        void (^drained)(NSError *) = _drained;
+        
+        _drained = nil;
+        [_items removeAllObjects];
+        
+        drained(_error);
+    }
+}
+
+@end
@@ -0,0 +1,337 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <XCTest/XCTest.h>
+
+#import "SMBFileServer.h"
+#import "SMBFile.h"
+#import "SMBMetrics.h"
+#import "SMBLatencyProxy.h"
+
+// The benchmarks run against a real server, optionally behind a local proxy that
+// adds latency and limits the bandwidth. They are configured by environment
+// variables of the scheme of the SMBClientBenchmarks target, and skipped if
+// SMB_BENCHMARK_HOST isn't set.
+//
+// SMB_BENCHMARK_HOST       ip address or hostname of the server
+// SMB_BENCHMARK_SHARE      a share with write access, "Guest Share" by default
+// SMB_BENCHMARK_USER       credentials, guest access if not set
+// SMB_BENCHMARK_PASSWORD
+// SMB_BENCHMARK_DOMAIN
+// SMB_BENCHMARK_LATENCY    one-way latency to add in milliseconds
+// SMB_BENCHMARK_BANDWIDTH  bandwidth in MBit/s
+// SMB_BENCHMARK_FILE_SIZE  size of the file for sequential and random access in
+//                          MB, 32 by default
+//
+// With latency or bandwidth set, the proxy listens on 127.0.0.1:445, as libdsm
+// only connects to that port. File sharing of the Mac running the simulator must
+// be off, otherwise the benchmarks are skipped.
+
+static NSString *directoryName = @"SMBClientBenchmarks";
+
+@interface SMBClientBenchmarks : XCTestCase
+
+@end
+
+@implementation SMBClientBenchmarks {
+    SMBLatencyProxy *_proxy;
+    SMBFileServer *_server;
+    SMBShare *_share;
+    SMBFile *_directory;
+    unsigned long long _fileSize;
+}
+
+- (BOOL)setUpWithError:(NSError **)outError {
+    if (![super setUpWithError:outError]) {
+        return NO;
+    }
+    
+    NSDictionary<NSString *, NSString *> *environment = [NSProcessInfo processInfo].environment;
+    NSString *host = environment[@"SMB_BENCHMARK_HOST"];
+    NSTimeInterval latency = environment[@"SMB_BENCHMARK_LATENCY"].doubleValue / 1000;
+    double bandwidth = environment[@"SMB_BENCHMARK_BANDWIDTH"].doubleValue * 1000 * 1000 / 8;
+    
+    _fileSize = (unsigned long long)MAX(environment[@"SMB_BENCHMARK_FILE_SIZE"].integerValue, 0) * 1024 * 1024 ?: 32 * 1024 * 1024;
+    
+    XCTSkipIf(host == nil, @"SMB_BENCHMARK_HOST isn't set");
+    
+    NSString *address = host;
+    
+    if (latency > 0 || bandwidth > 0) {
+        NSError *proxyError = nil;
+        
+        _proxy = [[SMBLatencyProxy alloc] initWithLocalAddress:@"127.0.0.1" port:445 remoteHost:host port:445 latency:latency bandwidth:bandwidth];
+        
+        XCTSkipUnless([_proxy start:&proxyError], @"Proxy not started, is file sharing on? %@", proxyError);
+        
+        address = @"127.0.0.1";
+    }
+    
+    __block NSError *error = nil;
+    __block SMBShare *share = nil;
+    
+    _server = [[SMBFileServer alloc] initWithHost:address netbiosName:host group:nil];
+    _server.completionQueue = dispatch_queue_create("smb_benchmark_queue", DISPATCH_QUEUE_SERIAL);
+    _server.maxSessions = 4;
+    
+    [self _wait:^(dispatch_block_t done) {
+        [self->_server connectAsUser:environment[@"SMB_BENCHMARK_USER"] password:environment[@"SMB_BENCHMARK_PASSWORD"] domain:environment[@"SMB_BENCHMARK_DOMAIN"] completion:^(BOOL guest, NSError *e) {
+            error = e;
+            done();
+        }];
+    }];
+    
+    XCTAssert(error == nil, @"Error: %@", error);
+    
+    [self _wait:^(dispatch_block_t done) {
+        [self->_server findShare:environment[@"SMB_BENCHMARK_SHARE"] ?: @"Guest Share" completion:^(SMBShare *s, NSError *e) {
+            share = s;
+            error = e;
+            done();
+        }];
+    }];
+    
+    XCTAssert(share != nil, @"Share not found: %@", error);
+    
+    [self _wait:^(dispatch_block_t done) {
+        [share open:^(NSError *e) {
+            error = e;
+            done();
+        }];
+    }];
+    
+    XCTAssert(error == nil, @"Error: %@", error);
+    
+    _share = share;
+    _directory = [SMBFile fileWithPath:directoryName share:share];
+    
+    [self _wait:^(dispatch_block_t done) {
+        [self->_directory createDirectories:^(NSError *e) {
+            error = e;
+            done();
+        }];
+    }];
+    
+    XCTAssert(error == nil, @"Error: %@", error);
+    
+    [_server resetMetrics];
+    
+    return YES;
+}
+
+- (void)tearDown {
+    if (_server) {
+        NSLog(@"%@", _server.metrics);
+        
+        [self _wait:^(dispatch_block_t done) {
+            [self->_directory deleteRecursively:4 progress:^BOOL(NSUInteger filesDeleted, unsigned long long bytesDeleted, BOOL complete, NSError *error) {
+                if (complete) {
+                    done();
+                }
+                return YES;
+            }];
+        }];
+        
+        [self _wait:^(dispatch_block_t done) {
+            [self->_server disconnect:done];
+        }];
+    }
+    
+    [_proxy stop];
+    
+    [super tearDown];
+}
+
+- (void)testListing {
+    NSUInteger count = 200;
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        [self _createFile:[NSString stringWithFormat:@"list_%lu", (unsigned long)i] size:0];
+    }
+    
+    [self measureBlock:^{
+        __block NSUInteger listed = 0;
+        
+        [self->_share invalidateMetadataCache];
+        
+        [self _wait:^(dispatch_block_t done) {
+            [self->_directory listFiles:^(NSArray<SMBFile *> *files, NSError *error) {
+                listed = files.count;
+                done();
+            }];
+        }];
+        
+        XCTAssertEqual(listed, count);
+    }];
+}
+
+- (void)testSmallFiles {
+    NSMutableArray<SMBFile *> *files = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 50; i++) {
+        [files addObject:[self _createFile:[NSString stringWithFormat:@"small_%lu", (unsigned long)i] size:4096]];
+    }
+    
+    [self measureBlock:^{
+        for (SMBFile *file in files) {
+            __block unsigned long long bytesRead = 0;
+            
+            [self _wait:^(dispatch_block_t done) {
+                [file open:SMBFileModeRead completion:^(NSError *error) {
+                    [file read:4096 progress:^BOOL(unsigned long long bytesReadTotal, NSData *data, BOOL complete, NSError *error) {
+                        if (complete) {
+                            bytesRead = bytesReadTotal;
+                            [file close:^(NSError *error) {
+                                done();
+                            }];
+                        }
+                        return YES;
+                    }];
+                }];
+            }];
+            
+            XCTAssertEqual(bytesRead, 4096);
+        }
+    }];
+}
+
+- (void)testSequentialRead {
+    SMBFile *file = [self _createFile:@"large_read" size:_fileSize];
+    
+    [self measureBlock:^{
+        __block unsigned long long bytesRead = 0;
+        NSDate *start = [NSDate date];
+        
+        [self _wait:^(dispatch_block_t done) {
+            [file open:SMBFileModeRead completion:^(NSError *error) {
+                [file read:1024 * 1024 maxBytes:0 window:4 progress:^BOOL(unsigned long long bytesReadTotal, NSData *data, BOOL complete, NSError *error) {
+                    if (complete) {
+                        bytesRead = bytesReadTotal;
+                        [file close:^(NSError *error) {
+                            done();
+                        }];
+                    }
+                    return YES;
+                }];
+            }];
+        }];
+        
+        XCTAssertEqual(bytesRead, self->_fileSize);
+        NSLog(@"Read %.1f MB/s", bytesRead / -start.timeIntervalSinceNow / 1024 / 1024);
+    }];
+}
+
+- (void)testSequentialWrite {
+    [self measureBlock:^{
+        NSDate *start = [NSDate date];
+        SMBFile *file = [self _createFile:@"large_write" size:self->_fileSize];
+        
+        XCTAssertNotNil(file);
+        NSLog(@"Wrote %.1f MB/s", self->_fileSize / -start.timeIntervalSinceNow / 1024 / 1024);
+    }];
+}
+
+- (void)testRandomReads {
+    SMBFile *file = [self _createFile:@"large_random" size:_fileSize];
+    
+    [self _wait:^(dispatch_block_t done) {
+        [file open:SMBFileModeRead completion:^(NSError *error) {
+            done();
+        }];
+    }];
+    
+    [self measureBlock:^{
+        srand48(0);
+        
+        // Each read depends on the previous one, as when parsing a file
+        for (NSUInteger i = 0; i < 200; i++) {
+            unsigned long long offset = (unsigned long long)(drand48() * (self->_fileSize - 4096));
+            __block NSUInteger length = 0;
+            
+            [self _wait:^(dispatch_block_t done) {
+                [file readAtOffset:offset length:4096 completion:^(NSData *data, NSError *error) {
+                    length = data.length;
+                    done();
+                }];
+            }];
+            
+            XCTAssertEqual(length, 4096);
+        }
+    }];
+    
+    [self _wait:^(dispatch_block_t done) {
+        [file close:^(NSError *error) {
+            done();
+        }];
+    }];
+}
+
+#pragma mark - Private methods
+
+// Runs the block and waits until it calls done
+- (void)_wait:(void (^)(dispatch_block_t done))block {
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    
+    block(^{
+        dispatch_semaphore_signal(semaphore);
+    });
+    
+    XCTAssertEqual(dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, 600 * NSEC_PER_SEC)), 0, @"Timed out");
+}
+
+- (SMBFile *)_createFile:(NSString *)name size:(unsigned long long)size {
+    SMBFile *file = [SMBFile fileWithPath:name relativeToFile:_directory];
+    NSData *chunk = [NSMutableData dataWithLength:1024 * 1024];
+    __block NSError *error = nil;
+    
+    [self _wait:^(dispatch_block_t done) {
+        [file open:SMBFileModeReadWrite completion:^(NSError *e) {
+            if (e) {
+                error = e;
+                done();
+                return;
+            }
+            
+            [file write:^NSData *(unsigned long long offset) {
+                if (offset >= size) {
+                    return nil;
+                }
+                return [chunk subdataWithRange:NSMakeRange(0, (NSUInteger)MIN(chunk.length, size - offset))];
+            } bufferSize:1024 * 1024 window:4 progress:^(unsigned long long bytesWrittenTotal, long bytesWrittenLast, BOOL complete, NSError *e) {
+                if (complete) {
+                    error = e;
+                    [file close:^(NSError *e) {
+                        done();
+                    }];
+                }
+            }];
+        }];
+    }];
+    
+    XCTAssert(error == nil, @"Error: %@", error);
+    
+    return error ? nil : file;
+}
+
+@end
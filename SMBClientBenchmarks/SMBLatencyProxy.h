@@ -0,0 +1,49 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <Foundation/Foundation.h>
+
+// Relays TCP connections from a local address to a server and delays the data in
+// both directions as a link with the given latency and bandwidth would
+@interface SMBLatencyProxy : NSObject
+
+// One-way delay in seconds
+@property (nonatomic, readonly) NSTimeInterval latency;
+// Bytes per second in each direction, 0 for unlimited
+@property (nonatomic, readonly) double bandwidth;
+// The port the proxy listens on. If 0 was given, the system picks one when the
+// proxy is started.
+@property (nonatomic, readonly) uint16_t localPort;
+
+- (nullable instancetype)initWithLocalAddress:(nonnull NSString *)localAddress port:(uint16_t)localPort remoteHost:(nonnull NSString *)remoteHost port:(uint16_t)remotePort latency:(NSTimeInterval)latency bandwidth:(double)bandwidth;
+
+- (BOOL)start:(NSError *_Nullable *_Nullable)error;
+- (void)stop;
+
+#pragma mark - Unavailable methods
+
++ new NS_UNAVAILABLE;
+- init NS_UNAVAILABLE;
+
+@end
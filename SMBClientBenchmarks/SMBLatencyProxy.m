@@ -0,0 +1,321 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import "SMBLatencyProxy.h"
+
+#import <arpa/inet.h>
+#import <netdb.h>
+#import <sys/socket.h>
+#import <unistd.h>
+
+// One direction of a relayed connection. Data read is queued with the time it
+// may be written, which is when the link would have delivered it.
+@interface SMBLatencyPipe : NSObject
+
+@property (nonatomic, copy) void (^closed)(void);
+
+- (instancetype)initFrom:(int)from to:(int)to latency:(NSTimeInterval)latency bandwidth:(double)bandwidth;
+- (void)start;
+- (void)cancel;
+
+@end
+
+@implementation SMBLatencyProxy {
+    NSString *_localAddress;
+    NSString *_remoteHost;
+    uint16_t _remotePort;
+    int _socket;
+    dispatch_queue_t _queue;
+    dispatch_source_t _acceptSource;
+    NSMutableSet<SMBLatencyPipe *> *_pipes;
+}
+
+- (instancetype)initWithLocalAddress:(NSString *)localAddress port:(uint16_t)localPort remoteHost:(NSString *)remoteHost port:(uint16_t)remotePort latency:(NSTimeInterval)latency bandwidth:(double)bandwidth {
+    self = [super init];
+    if (self) {
+        _localAddress = localAddress;
+        _localPort = localPort;
+        _remoteHost = remoteHost;
+        _remotePort = remotePort;
+        _latency = latency;
+        _bandwidth = bandwidth;
+        _socket = -1;
+        _queue = dispatch_queue_create("smb_latency_proxy_queue", DISPATCH_QUEUE_SERIAL);
+        _pipes = [NSMutableSet set];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self stop];
+}
+
+- (BOOL)start:(NSError **)error {
+    struct sockaddr_in address = {0};
+    socklen_t length = sizeof(address);
+    int yes = 1;
+    
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_port = htons(_localPort);
+    
+    _socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    
+    if (_socket < 0 ||
+        inet_pton(AF_INET, _localAddress.UTF8String, &address.sin_addr) != 1 ||
+        setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) != 0 ||
+        bind(_socket, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        getsockname(_socket, (struct sockaddr *)&address, &length) != 0 ||
+        listen(_socket, 16) != 0) {
+        
+        if (error) {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        }
+        [self stop];
+        return NO;
+    }
+    
+    _localPort = ntohs(address.sin_port);
+    _acceptSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, _socket, 0, _queue);
+    
+    __weak SMBLatencyProxy *weakSelf = self;
+    
+    dispatch_source_set_event_handler(_acceptSource, ^{
+        [weakSelf _accept];
+    });
+    dispatch_resume(_acceptSource);
+    
+    return YES;
+}
+
+- (void)stop {
+    if (_acceptSource) {
+        dispatch_source_cancel(_acceptSource);
+        _acceptSource = nil;
+    }
+    if (_socket >= 0) {
+        close(_socket);
+        _socket = -1;
+    }
+    
+    @synchronized (_pipes) {
+        for (SMBLatencyPipe *pipe in _pipes) {
+            [pipe cancel];
+        }
+        [_pipes removeAllObjects];
+    }
+}
+
+#pragma mark - Private methods
+
+- (void)_accept {
+    int client = accept(_socket, NULL, NULL);
+    
+    if (client < 0) {
+        return;
+    }
+    
+    int server = [self _connect];
+    
+    if (server < 0) {
+        close(client);
+        return;
+    }
+    
+    int yes = 1;
+    
+    // A connection closed by the other side must not raise SIGPIPE
+    setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+    setsockopt(server, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+    
+    SMBLatencyPipe *up = [[SMBLatencyPipe alloc] initFrom:client to:server latency:_latency bandwidth:_bandwidth];
+    SMBLatencyPipe *down = [[SMBLatencyPipe alloc] initFrom:server to:client latency:_latency bandwidth:_bandwidth];
+    __block NSUInteger open = 2;
+    
+    // The sockets are closed once both directions are done
+    void (^closed)(void) = ^{
+        BOOL last;
+        
+        @synchronized (self->_pipes) {
+            last = --open == 0;
+            
+            if (last) {
+                [self->_pipes removeObject:up];
+                [self->_pipes removeObject:down];
+            }
+        }
+        
+        if (last) {
+            close(client);
+            close(server);
+        }
+    };
+    
+    up.closed = closed;
+    down.closed = closed;
+    
+    @synchronized (_pipes) {
+        [_pipes addObject:up];
+        [_pipes addObject:down];
+    }
+    
+    [up start];
+    [down start];
+}
+
+- (int)_connect {
+    struct addrinfo hints = {0};
+    struct addrinfo *addresses = NULL;
+    NSString *port = [NSString stringWithFormat:@"%u", _remotePort];
+    int result = -1;
+    
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    
+    if (getaddrinfo(_remoteHost.UTF8String, port.UTF8String, &hints, &addresses) != 0) {
+        return -1;
+    }
+    
+    for (struct addrinfo *address = addresses; address && result < 0; address = address->ai_next) {
+        result = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        
+        if (result >= 0 && connect(result, address->ai_addr, address->ai_addrlen) != 0) {
+            close(result);
+            result = -1;
+        }
+    }
+    
+    freeaddrinfo(addresses);
+    
+    return result;
+}
+
+@end
+
+@implementation SMBLatencyPipe {
+    int _from;
+    int _to;
+    NSTimeInterval _latency;
+    double _bandwidth;
+    dispatch_queue_t _queue;
+    dispatch_source_t _source;
+    NSMutableArray<NSData *> *_pending;
+    NSTimeInterval _linkFree;
+    BOOL _finished;
+}
+
+- (instancetype)initFrom:(int)from to:(int)to latency:(NSTimeInterval)latency bandwidth:(double)bandwidth {
+    self = [super init];
+    if (self) {
+        _from = from;
+        _to = to;
+        _latency = latency;
+        _bandwidth = bandwidth;
+        _queue = dispatch_queue_create("smb_latency_pipe_queue", DISPATCH_QUEUE_SERIAL);
+        _pending = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (void)start {
+    _source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, _from, 0, _queue);
+    
+    dispatch_source_set_event_handler(_source, ^{
+        [self _read];
+    });
+    dispatch_resume(_source);
+}
+
+- (void)cancel {
+    dispatch_async(_queue, ^{
+        [self _finish];
+    });
+}
+
+#pragma mark - Private methods
+
+// Called on the queue of the pipe
+- (void)_read {
+    char buf[64 * 1024];
+    ssize_t length = read(_from, buf, sizeof(buf));
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    
+    if (length <= 0) {
+        // Let what's still on the way arrive before closing
+        dispatch_source_cancel(_source);
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)((MAX(_linkFree, now) - now + _latency) * NSEC_PER_SEC)), _queue, ^{
+            shutdown(self->_to, SHUT_WR);
+            [self _finish];
+        });
+        return;
+    }
+    
+    // The data occupies the link for a while and arrives after the latency
+    _linkFree = MAX(_linkFree, now) + (_bandwidth > 0 ? length / _bandwidth : 0);
+    
+    [_pending addObject:[NSData dataWithBytes:buf length:length]];
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)((_linkFree - now + _latency) * NSEC_PER_SEC)), _queue, ^{
+        [self _write];
+    });
+}
+
+// Writes the oldest data, so the order is kept even if timers fire out of order
+- (void)_write {
+    NSData *data = _pending.firstObject;
+    NSUInteger written = 0;
+    
+    if (data == nil) {
+        return;
+    }
+    [_pending removeObjectAtIndex:0];
+    
+    while (!_finished && written < data.length) {
+        ssize_t result = write(_to, (const char *)data.bytes + written, data.length - written);
+        
+        if (result <= 0) {
+            [self _finish];
+            break;
+        }
+        written += result;
+    }
+}
+
+- (void)_finish {
+    if (!_finished) {
+        _finished = YES;
+        
+        if (_source && !dispatch_source_testcancel(_source)) {
+            dispatch_source_cancel(_source);
+        }
+        [_pending removeAllObjects];
+        
+        if (self.closed) {
+            self.closed();
+            self.closed = nil;
+        }
+    }
+}
+
+@end
@@ -0,0 +1,155 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <XCTest/XCTest.h>
+
+#import "SMBLatencyProxy.h"
+
+#import <arpa/inet.h>
+#import <sys/socket.h>
+#import <unistd.h>
+
+// Checks the proxy itself, between two local sockets on ports the system picks,
+// so it runs without a server
+@interface SMBLatencyProxyTests : XCTestCase
+
+@end
+
+@implementation SMBLatencyProxyTests {
+    int _listener;
+    uint16_t _port;
+}
+
+- (void)setUp {
+    [super setUp];
+    
+    struct sockaddr_in address = {0};
+    socklen_t length = sizeof(address);
+    
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    
+    _listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    
+    XCTAssertGreaterThanOrEqual(_listener, 0);
+    XCTAssertEqual(bind(_listener, (struct sockaddr *)&address, sizeof(address)), 0);
+    XCTAssertEqual(getsockname(_listener, (struct sockaddr *)&address, &length), 0);
+    XCTAssertEqual(listen(_listener, 1), 0);
+    [self _setTimeout:_listener];
+    
+    _port = ntohs(address.sin_port);
+}
+
+- (void)tearDown {
+    close(_listener);
+    
+    [super tearDown];
+}
+
+- (void)testRelaysWithLatency {
+    SMBLatencyProxy *proxy = [[SMBLatencyProxy alloc] initWithLocalAddress:@"127.0.0.1" port:0 remoteHost:@"127.0.0.1" port:_port latency:0.1 bandwidth:0];
+    NSError *error = nil;
+    
+    XCTAssert([proxy start:&error], @"Proxy not started: %@", error);
+    XCTAssertNotEqual(proxy.localPort, 0);
+    
+    int client = [self _connect:proxy.localPort];
+    NSDate *start = [NSDate date];
+    
+    XCTAssertEqual(write(client, "ping", 4), 4);
+    
+    int server = accept(_listener, NULL, NULL);
+    
+    [self _setTimeout:server];
+    XCTAssertEqualObjects([self _read:4 from:server], @"ping");
+    XCTAssertGreaterThanOrEqual(-start.timeIntervalSinceNow, 0.1);
+    
+    XCTAssertEqual(write(server, "pong", 4), 4);
+    XCTAssertEqualObjects([self _read:4 from:client], @"pong");
+    XCTAssertGreaterThanOrEqual(-start.timeIntervalSinceNow, 0.2);
+    
+    close(server);
+    close(client);
+    [proxy stop];
+}
+
+- (void)testBusyPortFails {
+    SMBLatencyProxy *proxy = [[SMBLatencyProxy alloc] initWithLocalAddress:@"127.0.0.1" port:0 remoteHost:@"127.0.0.1" port:_port latency:0 bandwidth:0];
+    SMBLatencyProxy *other;
+    NSError *error = nil;
+    
+    XCTAssert([proxy start:&error], @"Proxy not started: %@", error);
+    
+    other = [[SMBLatencyProxy alloc] initWithLocalAddress:@"127.0.0.1" port:proxy.localPort remoteHost:@"127.0.0.1" port:_port latency:0 bandwidth:0];
+    
+    XCTAssertFalse([other start:&error]);
+    XCTAssertEqualObjects(error.domain, NSPOSIXErrorDomain);
+    
+    [proxy stop];
+}
+
+#pragma mark - Private methods
+
+- (int)_connect:(uint16_t)port {
+    struct sockaddr_in address = {0};
+    int result = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    
+    XCTAssertEqual(connect(result, (struct sockaddr *)&address, sizeof(address)), 0);
+    [self _setTimeout:result];
+    
+    return result;
+}
+
+// A test that fails mustn't hang, this also limits the wait for accept
+- (void)_setTimeout:(int)fd {
+    struct timeval timeout = {5, 0};
+    
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+- (NSString *)_read:(NSUInteger)length from:(int)fd {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    NSUInteger bytesRead = 0;
+    
+    while (bytesRead < length) {
+        ssize_t result = read(fd, (char *)data.mutableBytes + bytesRead, length - bytesRead);
+        
+        if (result <= 0) {
+            break;
+        }
+        bytesRead += result;
+    }
+    
+    data.length = bytesRead;
+    
+    return [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+}
+
+@end
@@ -0,0 +1,96 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <XCTest/XCTest.h>
+
+#import "SMBBlockCache.h"
+
+@interface SMBBlockCacheTests : XCTestCase
+
+@end
+
+@implementation SMBBlockCacheTests
+
+- (void)testSequentialAccessGrowsReadAhead {
+    SMBBlockCache *cache = [[SMBBlockCache alloc] initWithCapacity:256];
+    
+    XCTAssertEqual([cache readAheadForBlocksFrom:0 to:0], 1);
+    XCTAssertEqual([cache readAheadForBlocksFrom:1 to:1], 2);
+    XCTAssertEqual([cache readAheadForBlocksFrom:2 to:3], 4);
+    
+    // Continuing within the last block counts as sequential too
+    XCTAssertEqual([cache readAheadForBlocksFrom:3 to:4], 8);
+}
+
+- (void)testReadAheadIsCapped {
+    SMBBlockCache *cache = [[SMBBlockCache alloc] initWithCapacity:256];
+    NSUInteger readAhead = 0;
+    
+    for (unsigned long long i = 0; i < 20; i++) {
+        readAhead = [cache readAheadForBlocksFrom:i to:i];
+    }
+    XCTAssertEqual(readAhead, 32);
+    
+    // At most half of a small cache is read ahead, so the blocks asked for stay
+    cache = [[SMBBlockCache alloc] initWithCapacity:8];
+    
+    for (unsigned long long i = 0; i < 20; i++) {
+        readAhead = [cache readAheadForBlocksFrom:i to:i];
+    }
+    XCTAssertEqual(readAhead, 4);
+}
+
+- (void)testRandomAccessStopsReadAhead {
+    SMBBlockCache *cache = [[SMBBlockCache alloc] initWithCapacity:256];
+    
+    [cache readAheadForBlocksFrom:0 to:0];
+    [cache readAheadForBlocksFrom:1 to:1];
+    
+    XCTAssertEqual([cache readAheadForBlocksFrom:10 to:10], 0);
+    XCTAssertEqual([cache readAheadForBlocksFrom:11 to:11], 1);
+    
+    [cache removeAllBlocks];
+    
+    XCTAssertEqual([cache readAheadForBlocksFrom:11 to:11], 0);
+}
+
+- (void)testLeastRecentlyUsedBlockIsEvicted {
+    SMBBlockCache *cache = [[SMBBlockCache alloc] initWithCapacity:2];
+    NSData *a = [@"a" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *b = [@"b" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *c = [@"c" dataUsingEncoding:NSUTF8StringEncoding];
+    
+    [cache setBlock:a atIndex:0];
+    [cache setBlock:b atIndex:1];
+    
+    // Using block 0 makes block 1 the one to go
+    XCTAssertEqual([cache blockAtIndex:0], a);
+    [cache setBlock:c atIndex:2];
+    
+    XCTAssertEqual([cache blockAtIndex:0], a);
+    XCTAssertNil([cache blockAtIndex:1]);
+    XCTAssertEqual([cache blockAtIndex:2], c);
+}
+
+@end
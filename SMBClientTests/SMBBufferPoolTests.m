@@ -0,0 +1,92 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <XCTest/XCTest.h>
+
+#import "SMBBufferPool.h"
+
+#import <unistd.h>
+
+@interface SMBBufferPoolTests : XCTestCase
+
+@end
+
+@implementation SMBBufferPoolTests {
+    NSUInteger _pageSize;
+}
+
+- (void)setUp {
+    [super setUp];
+    
+    _pageSize = (NSUInteger)getpagesize();
+}
+
+- (void)testBuffersBeyondLimitDontWait {
+    SMBBufferPool *pool = [[SMBBufferPool alloc] initWithMemoryLimit:2 * _pageSize];
+    NSMutableArray<NSData *> *kept = [NSMutableArray array];
+    
+    // Data kept by the caller holds its buffer, the pool must not wait for it
+    for (NSUInteger i = 0; i < 8; i++) {
+        void *buffer = [pool acquireBuffer:_pageSize];
+        
+        XCTAssertTrue(buffer != NULL);
+        memset(buffer, (int)i, _pageSize);
+        [kept addObject:[pool dataWithBuffer:buffer size:_pageSize length:_pageSize]];
+    }
+    
+    for (NSUInteger i = 0; i < kept.count; i++) {
+        XCTAssertEqual(((const uint8_t *)kept[i].bytes)[_pageSize - 1], i);
+    }
+    
+    [kept removeAllObjects];
+    
+    // The pooled buffers came back
+    void *buffer = [pool acquireBuffer:_pageSize];
+    
+    XCTAssertTrue(buffer != NULL);
+    [pool releaseBuffer:buffer size:_pageSize];
+}
+
+- (void)testPooledBuffersAreReused {
+    SMBBufferPool *pool = [[SMBBufferPool alloc] initWithMemoryLimit:2 * _pageSize];
+    void *first = [pool acquireBuffer:_pageSize];
+    void *second = [pool acquireBuffer:_pageSize];
+    void *unpooled = [pool acquireBuffer:_pageSize];
+    
+    [pool releaseBuffer:unpooled size:_pageSize];
+    [pool releaseBuffer:second size:_pageSize];
+    
+    XCTAssertEqual([pool acquireBuffer:_pageSize], second);
+    
+    [pool releaseBuffer:first size:_pageSize];
+    [pool releaseBuffer:second size:_pageSize];
+}
+
+- (void)testBufferSizeIsRoundedToPages {
+    XCTAssertEqual([SMBBufferPool bufferSize:0], _pageSize);
+    XCTAssertEqual([SMBBufferPool bufferSize:_pageSize + 1], 2 * _pageSize);
+    XCTAssertEqual([SMBBufferPool bufferSize:SMBMaximumBufferSize + 1], SMBMaximumBufferSize);
+}
+
+@end
@@ -28,6 +28,8 @@
 #import "SMBFileServer.h"
 #import "SMBFile.h"
 
+#import <unistd.h>
+
 
 // netbios name, ip address or hostname of the server
 static NSString *host = @"server";
@@ -388,6 +390,64 @@ static NSString *domain = nil;
             
             [self waitForExpectationsWithTimeout:5.0 handler:nil];
             
+            // ----------------- File read kept chunks ----------------- //
+            
+            readExpectation = [self expectationWithDescription:@"File read kept chunks"];
+            
+            // Every chunk takes a page of the pool, the chunks kept exceed the limit
+            NSUInteger bufferMemoryLimit = server.bufferMemoryLimit;
+            
+            server.bufferMemoryLimit = 2 * (NSUInteger)getpagesize();
+            
+            [file open:SMBFileModeRead completion:^(NSError *error) {
+                XCTAssert(error == nil, @"Error: %@", error);
+                
+                if (error == nil) {
+                    
+                    const NSUInteger bufferSize = 3;
+                    NSMutableArray<NSData *> *chunks = [NSMutableArray new];
+                    
+                    [file read:bufferSize
+                      progress:^BOOL(unsigned long long bytesReadTotal, NSData * _Nullable data, BOOL complete, NSError * _Nullable error) {
+                          
+                          XCTAssert(error == nil, @"Error: %@", error);
+                          
+                          if (data) {
+                              [chunks addObject:data];
+                          }
+                          
+                          if (complete) {
+                              
+                              NSMutableData *result = [NSMutableData new];
+                              
+                              for (NSData *chunk in chunks) {
+                                  [result appendData:chunk];
+                              }
+                              
+                              NSString *s = [[NSString alloc] initWithData:result encoding:NSUTF8StringEncoding];
+                              
+                              XCTAssert(chunks.count > 2, @"Too few chunks");
+                              XCTAssert([s isEqualToString:@"Hello world!\n"], @"Unexpected result");
+                              
+                              [file close:^(NSError *error) {
+                                  [readExpectation fulfill];
+                                  
+                                  XCTAssert(error == nil, @"Error: %@", error);
+                              }];
+                          }
+                          
+                          return YES;
+                      }];
+                    
+                } else {
+                    [readExpectation fulfill];
+                }
+            }];
+            
+            [self waitForExpectationsWithTimeout:5.0 handler:nil];
+            
+            server.bufferMemoryLimit = bufferMemoryLimit;
+            
             // ----------------- File status ----------------- //
             
             XCTestExpectation *statusExpectation = [self expectationWithDescription:@"File status"];
@@ -486,6 +546,34 @@ static NSString *domain = nil;
             
             [self waitForExpectationsWithTimeout:5.0 handler:nil];
             
+            // ----------------- Download directory stopped ----------------- //
+            
+            XCTestExpectation *downloadDirExpectation = [self expectationWithDescription:@"Download directory stopped"];
+            
+            NSString *localPath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+            __block NSUInteger completeCount = 0;
+            
+            dir = [[SMBFile alloc] initWithPath:@"/a" share:testShare];
+            
+            [dir downloadDirectoryTo:localPath concurrency:1 progress:^BOOL(NSUInteger filesDownloaded, unsigned long long bytesDownloaded, BOOL complete, NSError * _Nullable error) {
+                XCTAssert(error == nil, @"Error: %@", error);
+                
+                if (complete) {
+                    completeCount++;
+                    
+                    [downloadDirExpectation fulfill];
+                }
+                
+                // Stops right after the first file, the final call must still come
+                return NO;
+            }];
+            
+            [self waitForExpectationsWithTimeout:5.0 handler:nil];
+            
+            XCTAssert(completeCount == 1, @"Completed %lu times", (unsigned long)completeCount);
+            
+            [[NSFileManager defaultManager] removeItemAtPath:localPath error:nil];
+            
             // ----------------- Delete file ----------------- //
             
             XCTestExpectation *deleteFileExpectation = [self expectationWithDescription:@"Delete file"];
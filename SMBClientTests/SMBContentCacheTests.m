@@ -0,0 +1,172 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <XCTest/XCTest.h>
+
+#import "SMBContentCache.h"
+#import "SMBShare_Protected.h"
+
+// A status with just a size and a timestamp, which is all the cache looks at
+@interface SMBContentCacheTestStat : SMBStat
+
+- (instancetype)initWithSize:(unsigned long long)size timestamp:(uint64_t)timestamp;
+
+@end
+
+@implementation SMBContentCacheTestStat {
+    unsigned long long _size;
+    uint64_t _timestamp;
+}
+
+- (instancetype)initWithSize:(unsigned long long)size timestamp:(uint64_t)timestamp {
+    self = [super initForNonExistingFile];
+    if (self) {
+        _size = size;
+        _timestamp = timestamp;
+    }
+    return self;
+}
+
+- (unsigned long long)size {
+    return _size;
+}
+
+- (uint64_t)writeTimestamp {
+    return _timestamp;
+}
+
+- (uint64_t)modificationTimestamp {
+    return _timestamp;
+}
+
+@end
+
+
+@interface SMBContentCacheTests : XCTestCase
+
+@end
+
+@implementation SMBContentCacheTests {
+    NSString *_directory;
+    SMBContentCache *_cache;
+}
+
+- (void)setUp {
+    [super setUp];
+    
+    _directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    _cache = [[SMBContentCache alloc] initWithDirectory:_directory];
+    _cache.sizeLimit = 10;
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:_directory error:nil];
+    
+    [super tearDown];
+}
+
+// Stores a copy of `length` bytes for path, as if the file was just read
+- (SMBStat *)_storeFile:(NSString *)path length:(NSUInteger)length timestamp:(uint64_t)timestamp {
+    SMBStat *stat = [[SMBContentCacheTestStat alloc] initWithSize:length timestamp:timestamp];
+    NSString *localPath = [_cache temporaryPath];
+    
+    [[NSMutableData dataWithLength:length] writeToFile:localPath atomically:NO];
+    [_cache storeFile:localPath forFile:path status:stat move:YES];
+    
+    return stat;
+}
+
+- (void)testCopyIsOnlyHandedOutWhileCurrent {
+    SMBStat *stat = [self _storeFile:@"/Dir/File" length:4 timestamp:1];
+    NSString *copy = [_cache pathOfFile:@"/dir/file" status:stat];
+    
+    XCTAssertNotNil(copy);
+    XCTAssertEqual([[NSFileManager defaultManager] attributesOfItemAtPath:copy error:nil].fileSize, 4);
+    XCTAssertNil([_cache pathOfFile:@"/Dir/File" status:[[SMBContentCacheTestStat alloc] initWithSize:4 timestamp:2]]);
+    XCTAssertNil([_cache pathOfFile:@"/Dir/Other" status:stat]);
+}
+
+- (void)testNewVersionReplacesTheOldOne {
+    SMBStat *old = [self _storeFile:@"/File" length:4 timestamp:1];
+    NSString *oldCopy = [_cache pathOfFile:@"/File" status:old];
+    SMBStat *current = [self _storeFile:@"/File" length:4 timestamp:2];
+    
+    XCTAssertNil([_cache pathOfFile:@"/File" status:old]);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:oldCopy]);
+    XCTAssertNotNil([_cache pathOfFile:@"/File" status:current]);
+    
+    // The replaced copy no longer counts, so both of these still fit
+    SMBStat *other = [self _storeFile:@"/Other" length:6 timestamp:1];
+    
+    XCTAssertNotNil([_cache pathOfFile:@"/File" status:current]);
+    XCTAssertNotNil([_cache pathOfFile:@"/Other" status:other]);
+}
+
+- (void)testLeastRecentlyUsedCopyIsRemovedOverTheLimit {
+    SMBStat *a = [self _storeFile:@"/A" length:4 timestamp:1];
+    SMBStat *b = [self _storeFile:@"/B" length:4 timestamp:1];
+    
+    // A was used longer ago than B
+    [[NSFileManager defaultManager] setAttributes:@{NSFileModificationDate: [NSDate distantPast]} ofItemAtPath:[_cache pathOfFile:@"/A" status:a] error:nil];
+    
+    SMBStat *c = [self _storeFile:@"/C" length:4 timestamp:1];
+    
+    XCTAssertNil([_cache pathOfFile:@"/A" status:a]);
+    XCTAssertNotNil([_cache pathOfFile:@"/B" status:b]);
+    XCTAssertNotNil([_cache pathOfFile:@"/C" status:c]);
+}
+
+- (void)testCopiesAlreadyOnDiskCount {
+    SMBStat *a = [self _storeFile:@"/A" length:6 timestamp:1];
+    
+    [[NSFileManager defaultManager] setAttributes:@{NSFileModificationDate: [NSDate distantPast]} ofItemAtPath:[_cache pathOfFile:@"/A" status:a] error:nil];
+    
+    // A new cache for the directory finds the copy of A, and makes room for B
+    _cache = [[SMBContentCache alloc] initWithDirectory:_directory];
+    _cache.sizeLimit = 10;
+    
+    SMBStat *b = [self _storeFile:@"/B" length:6 timestamp:1];
+    
+    XCTAssertNil([_cache pathOfFile:@"/A" status:a]);
+    XCTAssertNotNil([_cache pathOfFile:@"/B" status:b]);
+}
+
+- (void)testDisabledCacheStoresNothing {
+    _cache.sizeLimit = 0;
+    
+    SMBStat *stat = [self _storeFile:@"/File" length:4 timestamp:1];
+    
+    _cache.sizeLimit = 10;
+    
+    XCTAssertNil([_cache pathOfFile:@"/File" status:stat]);
+}
+
+- (void)testCachesAreSharedByDirectory {
+    SMBContentCache *cache = [SMBContentCache cacheWithDirectory:_directory];
+    
+    XCTAssertEqual([SMBContentCache cacheWithDirectory:_directory], cache);
+    XCTAssertNotEqual([SMBContentCache cacheWithDirectory:[_directory stringByAppendingPathComponent:@"other"]], cache);
+}
+
+@end
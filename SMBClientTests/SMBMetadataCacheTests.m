@@ -0,0 +1,149 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <XCTest/XCTest.h>
+
+#import "SMBMetadataCache.h"
+#import "SMBShare_Protected.h"
+
+// A status with just a name, which is all the cache looks at
+@interface SMBMetadataCacheTestStat : SMBStat
+
+- (instancetype)initWithName:(NSString *)name;
+
+@end
+
+@implementation SMBMetadataCacheTestStat {
+    NSString *_name;
+}
+
+- (instancetype)initWithName:(NSString *)name {
+    self = [super initForNonExistingFile];
+    if (self) {
+        _name = name;
+    }
+    return self;
+}
+
+- (NSString *)smbName {
+    return _name;
+}
+
+@end
+
+
+@interface SMBMetadataCacheTests : XCTestCase
+
+@end
+
+@implementation SMBMetadataCacheTests {
+    SMBMetadataCache *_cache;
+}
+
+- (void)setUp {
+    [super setUp];
+    
+    _cache = [SMBMetadataCache new];
+    _cache.lifetime = 60;
+}
+
+- (void)testStatIsCachedCaseInsensitively {
+    SMBStat *stat = [[SMBMetadataCacheTestStat alloc] initWithName:@"File.txt"];
+    
+    [_cache setStat:stat forPath:@"/Dir/File.txt" generation:_cache.generation];
+    
+    XCTAssertEqual([_cache statForPath:@"/dir/file.TXT"], stat);
+    XCTAssertEqual([_cache statForPath:@"\\Dir\\File.txt"], stat);
+    XCTAssertNil([_cache statForPath:@"/Dir/Other.txt"]);
+}
+
+- (void)testListingStoresTheStatusOfItsEntries {
+    SMBStat *a = [[SMBMetadataCacheTestStat alloc] initWithName:@"a"];
+    SMBStat *b = [[SMBMetadataCacheTestStat alloc] initWithName:@"b"];
+    
+    [_cache setListing:@[a, b] forPath:@"/Dir/" generation:_cache.generation];
+    
+    XCTAssertEqualObjects([_cache listingForPath:@"/Dir"], (@[a, b]));
+    XCTAssertEqual([_cache statForPath:@"/Dir/a"], a);
+    XCTAssertEqual([_cache statForPath:@"/Dir/b"], b);
+}
+
+- (void)testInvalidationDropsPathChildrenAndParentListing {
+    SMBStat *dir = [[SMBMetadataCacheTestStat alloc] initWithName:@"Dir"];
+    SMBStat *file = [[SMBMetadataCacheTestStat alloc] initWithName:@"file"];
+    SMBStat *sibling = [[SMBMetadataCacheTestStat alloc] initWithName:@"Dir2"];
+    
+    [_cache setListing:@[dir, sibling] forPath:@"/" generation:_cache.generation];
+    [_cache setListing:@[file] forPath:@"/Dir" generation:_cache.generation];
+    
+    [_cache invalidatePath:@"/Dir"];
+    
+    XCTAssertNil([_cache listingForPath:@"/"]);
+    XCTAssertNil([_cache statForPath:@"/Dir"]);
+    XCTAssertNil([_cache listingForPath:@"/Dir"]);
+    XCTAssertNil([_cache statForPath:@"/Dir/file"]);
+    XCTAssertEqual([_cache statForPath:@"/Dir2"], sibling);
+}
+
+- (void)testStaleResultsAreNotStored {
+    SMBStat *stat = [[SMBMetadataCacheTestStat alloc] initWithName:@"file"];
+    NSUInteger generation = _cache.generation;
+    
+    // The listing was searched before the invalidation, but arrives after it
+    [_cache invalidatePath:@"/Dir/file"];
+    [_cache setListing:@[stat] forPath:@"/Dir" generation:generation];
+    [_cache setStat:stat forPath:@"/Dir/file" generation:generation];
+    
+    XCTAssertNil([_cache listingForPath:@"/Dir"]);
+    XCTAssertNil([_cache statForPath:@"/Dir/file"]);
+    
+    [_cache setStat:stat forPath:@"/Dir/file" generation:_cache.generation];
+    
+    XCTAssertEqual([_cache statForPath:@"/Dir/file"], stat);
+}
+
+- (void)testEntriesExpire {
+    SMBStat *stat = [[SMBMetadataCacheTestStat alloc] initWithName:@"file"];
+    
+    _cache.lifetime = 0.1;
+    [_cache setStat:stat forPath:@"/file" generation:_cache.generation];
+    
+    XCTAssertEqual([_cache statForPath:@"/file"], stat);
+    
+    [NSThread sleepForTimeInterval:0.2];
+    
+    XCTAssertNil([_cache statForPath:@"/file"]);
+}
+
+- (void)testDisabledCacheStoresNothing {
+    SMBStat *stat = [[SMBMetadataCacheTestStat alloc] initWithName:@"file"];
+    
+    _cache.lifetime = 0;
+    [_cache setStat:stat forPath:@"/file" generation:_cache.generation];
+    _cache.lifetime = 60;
+    
+    XCTAssertNil([_cache statForPath:@"/file"]);
+}
+
+@end
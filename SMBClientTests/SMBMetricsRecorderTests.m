@@ -0,0 +1,107 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <XCTest/XCTest.h>
+
+#import "SMBMetricsRecorder.h"
+
+@interface SMBMetricsRecorderTests : XCTestCase
+
+@end
+
+@implementation SMBMetricsRecorderTests {
+    SMBMetricsRecorder *_server;
+    SMBMetricsRecorder *_file;
+}
+
+- (void)setUp {
+    [super setUp];
+    
+    _server = [[SMBMetricsRecorder alloc] initWithParent:nil];
+    _file = [[SMBMetricsRecorder alloc] initWithParent:[[SMBMetricsRecorder alloc] initWithParent:_server]];
+}
+
+- (void)testOperationsAreSummedUpByTheParents {
+    uint64_t start = [_file begin:SMBOperationOpen];
+    
+    XCTAssertEqual([_server.snapshot metricsForOperation:SMBOperationOpen].inFlight, 1);
+    
+    [_file end:SMBOperationOpen start:start result:0];
+    
+    for (SMBMetricsRecorder *recorder in @[_file, _server]) {
+        SMBOperationMetrics *open = [recorder.snapshot metricsForOperation:SMBOperationOpen];
+        
+        XCTAssertEqual(open.count, 1);
+        XCTAssertEqual(open.inFlight, 0);
+        XCTAssertEqual(open.failures, 0);
+    }
+}
+
+- (void)testResultsOfTransfersAreBytes {
+    [_file end:SMBOperationRead start:[_file begin:SMBOperationRead] result:100];
+    [_file end:SMBOperationRead start:[_file begin:SMBOperationRead] result:-1];
+    [_file end:SMBOperationWrite start:[_file begin:SMBOperationWrite] result:50];
+    [_file end:SMBOperationClose start:[_file begin:SMBOperationClose] result:-3];
+    
+    SMBMetrics *metrics = _server.snapshot;
+    
+    XCTAssertEqual(metrics.bytesRead, 100);
+    XCTAssertEqual(metrics.bytesWritten, 50);
+    XCTAssertEqual([metrics metricsForOperation:SMBOperationRead].count, 2);
+    XCTAssertEqual([metrics metricsForOperation:SMBOperationRead].failures, 1);
+    XCTAssertEqual([metrics metricsForOperation:SMBOperationClose].failures, 1);
+}
+
+- (void)testTogglingSignpostsDuringAnOperation {
+    _server.signpostsEnabled = YES;
+    
+    uint64_t start = [_file begin:SMBOperationStat];
+    
+    _server.signpostsEnabled = NO;
+    [_file end:SMBOperationStat start:start result:0];
+    
+    SMBOperationMetrics *stat = [_server.snapshot metricsForOperation:SMBOperationStat];
+    
+    XCTAssertEqual(stat.count, 1);
+    XCTAssertGreaterThanOrEqual(stat.totalDuration, 0);
+    XCTAssertLessThan(stat.totalDuration, 1);
+}
+
+- (void)testResetKeepsOperationsInFlight {
+    uint64_t start = [_file begin:SMBOperationFind];
+    
+    [_file end:SMBOperationFind start:[_file begin:SMBOperationFind] result:0];
+    [_server reset];
+    
+    SMBOperationMetrics *find = [_server.snapshot metricsForOperation:SMBOperationFind];
+    
+    XCTAssertEqual(find.count, 0);
+    XCTAssertEqual(find.inFlight, 1);
+    
+    [_file end:SMBOperationFind start:start result:0];
+    
+    XCTAssertEqual([_server.snapshot metricsForOperation:SMBOperationFind].inFlight, 0);
+}
+
+@end
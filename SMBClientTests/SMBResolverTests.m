@@ -0,0 +1,115 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <XCTest/XCTest.h>
+
+#import "SMBResolver.h"
+
+#import <arpa/inet.h>
+#import <sys/socket.h>
+#import <unistd.h>
+
+@interface SMBResolverTests : XCTestCase
+
+@end
+
+@implementation SMBResolverTests {
+    SMBResolver *_resolver;
+}
+
+- (void)setUp {
+    [super setUp];
+    
+    _resolver = [SMBResolver new];
+}
+
+- (in_addr_t)_address:(NSString *)string {
+    return inet_addr(string.UTF8String);
+}
+
+- (void)testAddressIsReturnedAsIs {
+    NSArray<NSNumber *> *addresses = [_resolver addressesOfHost:@"192.168.1.10" error:nil];
+    
+    XCTAssertEqualObjects(addresses, @[@([self _address:@"192.168.1.10"])]);
+}
+
+- (void)testAddedAddressesComeFirst {
+    [_resolver addAddress:[self _address:@"10.0.0.1"] forHost:@"NAS"];
+    [_resolver addAddress:[self _address:@"10.0.0.2"] forHost:@"nas"];
+    
+    XCTAssertEqualObjects([_resolver addressesOfHost:@"Nas" error:nil], (@[@([self _address:@"10.0.0.2"]), @([self _address:@"10.0.0.1"])]));
+}
+
+- (void)testPreferredAddressIsVerified {
+    [_resolver addAddress:[self _address:@"10.0.0.1"] forHost:@"nas"];
+    [_resolver addAddress:[self _address:@"10.0.0.2"] forHost:@"nas"];
+    
+    XCTAssertNil([_resolver verifiedAddressOfHost:@"nas"]);
+    
+    [_resolver preferAddress:[self _address:@"10.0.0.1"] forHost:@"NAS"];
+    
+    XCTAssertEqualObjects([_resolver addressesOfHost:@"nas" error:nil].firstObject, @([self _address:@"10.0.0.1"]));
+    XCTAssertEqualObjects([_resolver verifiedAddressOfHost:@"nas"], @([self _address:@"10.0.0.1"]));
+    
+    // Only addresses of the host count
+    [_resolver preferAddress:[self _address:@"10.0.0.3"] forHost:@"nas"];
+    
+    XCTAssertEqualObjects([_resolver verifiedAddressOfHost:@"nas"], @([self _address:@"10.0.0.1"]));
+    
+    [_resolver removeAddressesOfHost:@"nas"];
+    
+    XCTAssertNil([_resolver verifiedAddressOfHost:@"nas"]);
+}
+
+- (void)testVerifiedAddressExpires {
+    [_resolver addAddress:[self _address:@"10.0.0.1"] forHost:@"nas"];
+    [_resolver preferAddress:[self _address:@"10.0.0.1"] forHost:@"nas"];
+    
+    _resolver.timeToLive = 0;
+    
+    XCTAssertNil([_resolver verifiedAddressOfHost:@"nas"]);
+}
+
+- (void)testReachableAddressIsTheOneListening {
+    struct sockaddr_in address = {0};
+    socklen_t length = sizeof(address);
+    int listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = [self _address:@"127.0.0.1"];
+    
+    XCTAssertEqual(bind(listener, (struct sockaddr *)&address, sizeof(address)), 0);
+    XCTAssertEqual(getsockname(listener, (struct sockaddr *)&address, &length), 0);
+    XCTAssertEqual(listen(listener, 4), 0);
+    
+    // Nothing listens on the port of the first address
+    NSArray<NSNumber *> *addresses = @[@([self _address:@"127.0.0.2"]), @([self _address:@"127.0.0.1"])];
+    
+    XCTAssertEqual([_resolver reachableAddress:addresses port:ntohs(address.sin_port) timeout:2], [self _address:@"127.0.0.1"]);
+    
+    close(listener);
+}
+
+@end
@@ -0,0 +1,124 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <XCTest/XCTest.h>
+
+#import "SMBSessionRegistry.h"
+
+@interface SMBSessionRegistryTests : XCTestCase
+
+@end
+
+@implementation SMBSessionRegistryTests {
+    SMBSessionRegistry *_registry;
+}
+
+- (void)setUp {
+    [super setUp];
+    
+    _registry = [SMBSessionRegistry new];
+    _registry.idleTimeout = 60;
+}
+
+- (void)tearDown {
+    [_registry removeAllSessions];
+    
+    [super tearDown];
+}
+
+- (void)testMostRecentSessionIsTakenFirst {
+    smb_session *first = smb_session_new();
+    smb_session *second = smb_session_new();
+    NSDictionary<NSString *, NSNumber *> *shareIDs = nil;
+    
+    [_registry addSession:first shareIDs:@{ @"data" : @1 } forKey:@"key"];
+    [_registry addSession:second shareIDs:@{ @"data" : @2 } forKey:@"key"];
+    
+    XCTAssertEqual([_registry takeSessionForKey:@"key" shareIDs:&shareIDs], second);
+    XCTAssertEqualObjects(shareIDs, @{ @"data" : @2 });
+    XCTAssertEqual([_registry takeSessionForKey:@"key" shareIDs:&shareIDs], first);
+    XCTAssertEqualObjects(shareIDs, @{ @"data" : @1 });
+    XCTAssertTrue([_registry takeSessionForKey:@"key" shareIDs:&shareIDs] == NULL);
+    XCTAssertNil(shareIDs);
+    
+    smb_session_destroy(first);
+    smb_session_destroy(second);
+}
+
+- (void)testSessionsAreKeptPerKey {
+    smb_session *session = smb_session_new();
+    
+    [_registry addSession:session shareIDs:nil forKey:@"key"];
+    
+    XCTAssertTrue([_registry takeSessionForKey:@"other" shareIDs:nil] == NULL);
+    XCTAssertEqual([_registry takeSessionForKey:@"key" shareIDs:nil], session);
+    
+    smb_session_destroy(session);
+}
+
+- (void)testSessionsAreDestroyedWithoutIdleTimeout {
+    _registry.idleTimeout = 0;
+    
+    [_registry addSession:smb_session_new() shareIDs:nil forKey:@"key"];
+    
+    XCTAssertTrue([_registry takeSessionForKey:@"key" shareIDs:nil] == NULL);
+}
+
+- (void)testOldestSessionIsEvictedBeyondMaximum {
+    smb_session *second = smb_session_new();
+    smb_session *third = smb_session_new();
+    
+    _registry.maxIdleSessions = 2;
+    
+    [_registry addSession:smb_session_new() shareIDs:nil forKey:@"key"];
+    [_registry addSession:second shareIDs:nil forKey:@"key"];
+    [_registry addSession:third shareIDs:nil forKey:@"key"];
+    
+    XCTAssertEqual([_registry takeSessionForKey:@"key" shareIDs:nil], third);
+    XCTAssertEqual([_registry takeSessionForKey:@"key" shareIDs:nil], second);
+    XCTAssertTrue([_registry takeSessionForKey:@"key" shareIDs:nil] == NULL);
+    
+    smb_session_destroy(second);
+    smb_session_destroy(third);
+}
+
+- (void)testExpiredSessionsAreEvicted {
+    _registry.idleTimeout = 0.1;
+    
+    [_registry addSession:smb_session_new() shareIDs:nil forKey:@"key"];
+    [NSThread sleepForTimeInterval:0.2];
+    
+    XCTAssertTrue([_registry takeSessionForKey:@"key" shareIDs:nil] == NULL);
+}
+
+- (void)testKeyIgnoresCaseOfHostAndDomain {
+    NSString *key = [SMBSessionRegistry keyForHost:@"NAS" domain:@"WORKGROUP" username:@"user" password:@"secret"];
+    
+    XCTAssertEqualObjects(key, [SMBSessionRegistry keyForHost:@"nas" domain:@"workgroup" username:@"user" password:@"secret"]);
+    XCTAssertNotEqualObjects(key, [SMBSessionRegistry keyForHost:@"nas" domain:@"workgroup" username:@"User" password:@"secret"]);
+    XCTAssertNotEqualObjects(key, [SMBSessionRegistry keyForHost:@"nas" domain:@"workgroup" username:@"user" password:@"other"]);
+    XCTAssertFalse([key containsString:@"secret"]);
+}
+
+@end
@@ -0,0 +1,91 @@
+// -----------------------------------------------------------------------------
+// This file is part of SMBClient.
+// Copyright © 2016 Naxos Software Solutions GmbH.
+//
+// Author: Martin Schaefer <martin.schaefer@naxos-software.de>
+//
+// SMBClient is licensed under the GNU Lesser General Public License version 2.1
+// or later
+// -----------------------------------------------------------------------------
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+// -----------------------------------------------------------------------------
+
+#import <XCTest/XCTest.h>
+
+#import "SMBTransferRecord.h"
+
+@interface SMBTransferRecordTests : XCTestCase
+
+@end
+
+@implementation SMBTransferRecordTests {
+    SMBTransferRecord *_record;
+    NSDictionary *_source;
+    NSDictionary *_target;
+}
+
+- (void)setUp {
+    [super setUp];
+    
+    _record = [[SMBTransferRecord alloc] initWithKey:[NSUUID UUID].UUIDString];
+    _source = @{@"size": @100, @"modificationTime": @1};
+    _target = @{@"size": @50, @"modificationTime": @2};
+}
+
+- (void)tearDown {
+    [_record remove];
+    
+    [super tearDown];
+}
+
+- (void)testOffsetNeedsTheSameSource {
+    [_record setOffset:40 source:_source target:nil];
+    
+    XCTAssertEqual([_record offsetForSource:_source target:nil limit:50], 40);
+    XCTAssertEqual([_record offsetForSource:@{@"size": @100, @"modificationTime": @3} target:nil limit:50], 0);
+}
+
+- (void)testOffsetNeedsTheTargetToReachIt {
+    [_record setOffset:40 source:_source target:nil];
+    
+    XCTAssertEqual([_record offsetForSource:_source target:nil limit:39], 0);
+}
+
+- (void)testOffsetNeedsTheSameTarget {
+    [_record setOffset:40 source:_source target:_target];
+    
+    XCTAssertEqual([_record offsetForSource:_source target:_target limit:50], 40);
+    XCTAssertEqual([_record offsetForSource:_source target:@{@"size": @50, @"modificationTime": @4} limit:50], 0);
+}
+
+- (void)testTargetCanBeReplaced {
+    NSDictionary *closed = @{@"size": @50, @"modificationTime": @5};
+    
+    [_record setOffset:40 source:_source target:_target];
+    [_record setTarget:closed];
+    
+    XCTAssertEqual([_record offsetForSource:_source target:closed limit:50], 40);
+    XCTAssertEqual([_record offsetForSource:_source target:_target limit:50], 0);
+}
+
+- (void)testRemovedRecordHasNoOffset {
+    [_record setOffset:40 source:_source target:nil];
+    [_record remove];
+    [_record setTarget:_target];
+    
+    XCTAssertEqual([_record offsetForSource:_source target:_target limit:50], 0);
+}
+
+@end